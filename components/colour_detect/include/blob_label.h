@@ -0,0 +1,166 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "pixel_mask.h"
+#include "detect_arena.h"
+
+// Structure for detected regions
+typedef struct
+{
+    int x_center;
+    int y_center;
+    int pixel_count;
+    int min_x;
+    int max_x;
+    int min_y;
+    int max_y;
+} blob_t;
+
+// Class ids are bytes; 0 is background
+#define BLOB_CLASS_IDS 256
+
+// Horizontal run of pixels of one class, x0..x1 inclusive
+typedef struct
+{
+    int x0;
+    int x1;
+    int label;
+    int class_id;
+} blob_run_t;
+
+// Per-label accumulators; only meaningful while the label is its own root
+typedef struct
+{
+    int parent;
+    int class_id;
+    int first; // raster index of the first pixel, orders blobs like the flood fill
+    int seen;  // last row that still had a run of this component (retire mode)
+    int pixel_count;
+    int64_t sum_x;
+    int64_t sum_y;
+    int min_x;
+    int max_x;
+    int min_y;
+    int max_y;
+} blob_label_stats_t;
+
+// Called once per finished component in retire mode
+typedef void (*blob_retire_fn)(void *ctx, const blob_label_stats_t *stats);
+
+// Row-at-a-time run labeler. Two pixels of the same class belong to the same
+// blob when they are at most max_gap apart in both x and y (the old 7x7 flood-fill window for
+// MAX_GAP = 3), so only the runs of the last max_gap rows are kept. Label
+// storage grows with the number of runs, not with the image size.
+//
+// In retire mode a component is handed to the callback as soon as no run in
+// the last max_gap rows belongs to it any more, and its label is recycled, so
+// memory is bounded by the runs in flight rather than by the frame.
+typedef struct
+{
+    int width;
+    int height;
+    int max_gap;
+    int first_row; // image row of the first pushed row
+    int y;         // next row to be pushed
+
+    // optional copy of the first max_gap rows, for stitching bands together
+    blob_run_t *head_runs;
+    int *head_run_count;
+    int head_capacity;
+
+    // ring of the last max_gap + 1 rows of runs, row_capacity runs per row,
+    // grown when a row has more runs
+    blob_run_t *runs;
+    int *row_run_count;
+    int ring_rows;
+    int row_capacity;
+
+    // label_row scratch, kept here rather than on a worker's stack
+    int *scan; // per previous row, first run that may still connect
+    int *last; // per class id, last run seen in the current row
+
+    blob_label_stats_t *labels;
+    int label_count; // slots handed out so far
+    int label_capacity;
+
+    // retire mode: labels still in use, and a free list threaded through parent
+    blob_retire_fn retire;
+    void *retire_ctx;
+    int *active;
+    int active_count;
+    int free_label;
+
+    detect_arena_t *arena; // where the tables live, NULL for the heap
+} blob_labeler_t;
+
+bool blob_labeler_init(blob_labeler_t *lab, int width, int height, int max_gap);
+// Same, with every table taken from arena; tables that grow keep their size
+// across resets, so a labeler reused for many frames stops allocating
+bool blob_labeler_init_in(blob_labeler_t *lab, int width, int height, int max_gap, detect_arena_t *arena);
+void blob_labeler_reset(blob_labeler_t *lab, int first_row);
+void blob_labeler_free(blob_labeler_t *lab);
+
+// Labels rows narrower than the labeler was made for, e.g. one box of the
+// frame at a time; call before blob_labeler_reset
+void blob_labeler_set_width(blob_labeler_t *lab, int width);
+
+// Also remember the runs of the first max_gap rows after each reset
+bool blob_labeler_keep_head(blob_labeler_t *lab);
+
+// Switch to retire mode; blob_labeler_next is not available in this mode.
+// Calling it again only swaps the callback.
+bool blob_labeler_set_retire(blob_labeler_t *lab, blob_retire_fn retire, void *ctx);
+
+// Retire every component still open, call after the last row of a frame
+void blob_labeler_flush(blob_labeler_t *lab);
+
+// Runs of an image row that is either among the last max_gap + 1 pushed rows
+// or, with keep_head, among the first max_gap rows. NULL if no longer held.
+const blob_run_t *blob_labeler_row_runs(const blob_labeler_t *lab, int y, int *count);
+
+// Union-find over label stats, shared with code that merges labels from
+// several labelers. The lower label always becomes the root; the root keeps
+// the smaller first pixel index.
+int blob_label_find(blob_label_stats_t *labels, int label);
+int blob_label_union(blob_label_stats_t *labels, int a, int b);
+void blob_label_to_blob(const blob_label_stats_t *stats, blob_t *blob);
+
+// True if two runs from rows at most max_gap apart belong to the same blob
+static inline bool blob_runs_touch(const blob_run_t *a, const blob_run_t *b, int max_gap)
+{
+    return a->class_id == b->class_id && b->x0 <= a->x1 + max_gap && b->x1 >= a->x0 - max_gap;
+}
+
+// Feed the next row of a packed mask (pixel_mask_row layout), as class 1
+bool blob_labeler_push_row(blob_labeler_t *lab, const uint32_t *row_bits);
+
+// Feed the next row of a mask dilated by pixel_morph_gap_box, for a labeler
+// made with max_gap 1: the bridged row decides which pixels connect, the
+// undilated row_bits are counted, so the components match a labeler with the
+// full max_gap on the undilated mask, blob order and statistics included
+bool blob_labeler_push_bridged_row(blob_labeler_t *lab, const uint32_t *bridged_bits, const uint32_t *row_bits,
+                                   int class_id);
+
+// Feed the next row of a class-id map; every non-zero class is labeled in
+// the same sweep and runs only join runs of their own class
+bool blob_labeler_push_class_row(blob_labeler_t *lab, const uint8_t *class_ids);
+
+// Feed the next row as runs already extracted from it, sorted by x0 (only
+// x0, x1 and class_id are read)
+bool blob_labeler_push_runs(blob_labeler_t *lab, const blob_run_t *runs, int count);
+
+// Run extraction used by blob_labeler_push_class_row, for callers that cache
+// the runs of rows that did not change
+int blob_count_class_runs(const uint8_t *class_ids, int width);
+int blob_extract_class_runs(const uint8_t *class_ids, int width, blob_run_t *runs);
+
+// Iterates finished components in the raster order of their first pixel, the
+// same order the flood fill discovered them in. Start with *cursor = 0;
+// returns NULL after the last one.
+const blob_label_stats_t *blob_labeler_next(blob_labeler_t *lab, int *cursor);
+
+// Original DFS flood fill, kept as the reference for benchmarks and checks.
+// Returns the number of blobs with at least min_pixels pixels, up to max_blobs.
+int find_blobs_flood(const pixel_mask_t *pixel_mask, int max_gap, int min_pixels,
+                     blob_t *blobs, int max_blobs);
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "colour_detect.h"
+
+// Gives blobs persistent ids across frames. A blob continues the track of its
+// class whose last box overlaps it most or, without overlap, whose centre is
+// nearest within max_distance. Unmatched blobs start new tracks; tracks
+// without a match for more than max_missed frames are dropped.
+#define BLOB_TRACK_MAX (CLASS_LUT_MAX_CLASSES * DETECT_MAX_BLOBS)
+
+typedef struct
+{
+    int id;
+    int class_id;
+    blob_t blob;
+    int age;    // frames the track has been matched in
+    int missed; // consecutive frames without a match
+} blob_track_t;
+
+typedef struct
+{
+    int max_distance;
+    int max_missed;
+    int next_id;
+    blob_track_t tracks[BLOB_TRACK_MAX];
+    int track_count;
+    // track id of each blob of the last result, -1 if no track slot was free
+    int ids[CLASS_LUT_MAX_CLASSES][DETECT_MAX_BLOBS];
+} blob_tracker_t;
+
+void blob_tracker_init(blob_tracker_t *tracker, int max_distance, int max_missed);
+
+// Associates the kept blobs of a frame with the tracks and fills ids
+void blob_tracker_update(blob_tracker_t *tracker, const frame_result_t *result);
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "hsv.h"
+
+// Table-free classification of RGB565 pixels: the same result as
+// rgb565_to_hsv + matches_threshold with first match winning, computed
+// several pixels at a time without branches or divisions.
+//
+// Hue of the reference conversion only ever takes the values 0, 15, ... 90
+// (its (g - b) / delta is -1, 0 or 1), so it is chosen by channel compares;
+// the saturation bounds become products, s >= s_min <=> delta * 255 >=
+// s_min * max, all of which fit 16-bit lanes.
+#define CLASS_KERNEL_MAX_CLASSES 8
+
+typedef enum
+{
+    CLASS_KERNEL_SWAR,   // portable C, 2 pixels per 32-bit word
+    CLASS_KERNEL_VECTOR, // GCC / Clang vector extensions, 8 pixels per step
+    CLASS_KERNEL_SSE2,   // x86 hosts, 8 pixels per step
+    CLASS_KERNEL_AVX2,   // x86 hosts with AVX2, 16 pixels per step
+    CLASS_KERNEL_COUNT,
+} class_kernel_variant_t;
+
+// Chosen at build time, e.g. -DCLASS_KERNEL_DEFAULT=CLASS_KERNEL_VECTOR;
+// otherwise the widest variant the compiler targets
+#ifndef CLASS_KERNEL_DEFAULT
+#if defined(__AVX2__)
+#define CLASS_KERNEL_DEFAULT CLASS_KERNEL_AVX2
+#elif defined(__SSE2__)
+#define CLASS_KERNEL_DEFAULT CLASS_KERNEL_SSE2
+#elif defined(__ARM_NEON)
+#define CLASS_KERNEL_DEFAULT CLASS_KERNEL_VECTOR
+#else
+#define CLASS_KERNEL_DEFAULT CLASS_KERNEL_SWAR
+#endif
+#endif
+
+// One threshold as the kernel compares it
+typedef struct
+{
+    uint16_t h_min;
+    uint16_t h_max;
+    uint16_t v_min;
+    uint16_t v_max;
+    uint16_t s_min;   // delta * 255 >= s_min * max
+    uint16_t s_limit; // delta * 255 < s_limit * max, s_max + 1
+} class_kernel_bounds_t;
+
+typedef struct
+{
+    class_kernel_bounds_t bounds[CLASS_KERNEL_MAX_CLASSES];
+    int class_count;
+    bool swapped; // pixels are byte-swapped RGB565
+    class_kernel_variant_t variant;
+} class_kernel_t;
+
+// Falls back to CLASS_KERNEL_SWAR if variant cannot run here
+void class_kernel_init(class_kernel_t *kernel, class_kernel_variant_t variant, const color_threshold_t *thresholds,
+                       int count, bool swapped);
+
+// Whether a variant is compiled in and the CPU supports it
+bool class_kernel_available(class_kernel_variant_t variant);
+const char *class_kernel_name(class_kernel_variant_t variant);
+bool class_kernel_parse(const char *name, class_kernel_variant_t *variant);
+
+// Classifies count <= 32 pixels: bit i of bits[c] is set if pixel i has
+// class id c + 1, bits[0 .. class_count - 1] are written
+void class_kernel_classify(const class_kernel_t *kernel, const uint16_t *pixels, int count, uint32_t *bits);
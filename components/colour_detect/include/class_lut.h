@@ -0,0 +1,79 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "hsv.h"
+#include "pixel_mask.h"
+#include "pixel_format.h"
+#include "class_kernel.h"
+
+// Every RGB565 value maps to one byte: 0 = no match, otherwise 1 + index of the
+// first threshold that matches (same priority as the old if/else-if chain).
+// A table built for another pixel format is indexed by that format's native
+// 16-bit index instead (see pixel_format.h), so its pixels are classified
+// without being converted.
+#define CLASS_LUT_SIZE 65536
+#define CLASS_LUT_MAX_CLASSES CLASS_KERNEL_MAX_CLASSES
+#define CLASS_NONE 0
+
+// Where the 64 KB table lives
+typedef enum
+{
+    CLASS_LUT_MEM_INTERNAL, // internal SRAM, fastest lookups
+    CLASS_LUT_MEM_PSRAM,    // frees 64 KB of internal SRAM for other work
+    CLASS_LUT_MEM_NONE,     // no table, class_kernel.h classifies every pixel
+} class_lut_mem_t;
+
+typedef struct
+{
+    uint8_t *table; // NULL for CLASS_LUT_MEM_NONE
+    class_kernel_t kernel; // used instead of the table
+    class_lut_mem_t mem;
+    pixel_format_t format; // layout of the pixels the table is indexed by
+    // copy of the thresholds the table was built from, to skip needless rebuilds
+    color_threshold_t thresholds[CLASS_LUT_MAX_CLASSES];
+    int class_count;
+    bool built;
+} class_lut_t;
+
+bool class_lut_init(class_lut_t *lut, class_lut_mem_t mem);
+// Same for frames in another format; class_lut_init is PIXEL_FORMAT_RGB565
+bool class_lut_init_format(class_lut_t *lut, class_lut_mem_t mem, pixel_format_t format);
+// Kernel variant for CLASS_LUT_MEM_NONE, CLASS_KERNEL_DEFAULT unless set;
+// false if it cannot run here
+bool class_lut_set_kernel(class_lut_t *lut, class_kernel_variant_t variant);
+void class_lut_free(class_lut_t *lut);
+
+// Rebuilds the table (or the kernel bounds) only if the threshold set differs from the last build.
+// Returns true if a rebuild happened.
+bool class_lut_update(class_lut_t *lut, const color_threshold_t *thresholds, int count);
+
+// Compares the table, or the kernel, against rgb565_to_hsv + matches_threshold
+// for all 65536 inputs (each decoded to the RGB565 colour it stands for),
+// returns the number of mismatching entries (0 means bit-exact)
+int class_lut_verify(const class_lut_t *lut);
+
+// Class of one format index through the kernel, for CLASS_LUT_MEM_NONE
+uint8_t class_lut_classify_index(const class_lut_t *lut, uint16_t index);
+
+// index is an RGB565 value for an RGB565 table
+static inline uint8_t class_lut_lookup(const class_lut_t *lut, uint16_t index)
+{
+    if (lut->table == NULL)
+        return class_lut_classify_index(lut, index);
+    return lut->table[index];
+}
+
+// Class of pixel x of a row in the table's format
+static inline uint8_t class_lut_lookup_at(const class_lut_t *lut, const uint8_t *row, int x)
+{
+    return class_lut_lookup(lut, pixel_format_index(lut->format, row, x));
+}
+
+// Classifies one image row into one packed mask per class (masks[c] receives
+// class id c + 1), 32 pixels per mask word store
+void class_lut_classify_row(const class_lut_t *lut, const uint8_t *row, int y, pixel_mask_t *masks);
+
+// Classifies pixels x0 .. x0 + width - 1 of one image row, in the table's
+// format, into a class-id row, one byte per pixel
+void class_lut_classify_ids(const class_lut_t *lut, const uint8_t *row, int x0, int width, uint8_t *class_ids);
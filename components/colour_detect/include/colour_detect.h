@@ -0,0 +1,77 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "hsv.h"
+#include "class_lut.h"
+#include "blob_label.h"
+
+#define COLOUR_NAME_LEN 16
+#define DETECT_MAX_BLOBS 10
+
+// One colour class of the runtime table. Class id = index in the registry + 1,
+// earlier entries win where thresholds overlap.
+typedef struct
+{
+    char name[COLOUR_NAME_LEN];
+    color_threshold_t thresh;
+    float min_percent; // frame coverage needed before blobs are considered
+    float aspect_min;  // blob width/height must lie strictly inside
+    float aspect_max;  // (aspect_min, aspect_max); aspect_max 0 disables the check
+} colour_class_t;
+
+typedef struct
+{
+    colour_class_t classes[CLASS_LUT_MAX_CLASSES];
+    int count;
+} colour_registry_t;
+
+// Parses a colour table, one class per line:
+//   name h_min h_max s_min s_max v_min v_max min_percent [aspect_min aspect_max]
+// Blank lines and lines starting with '#' are skipped. Returns the number of
+// classes loaded, or -1 on a malformed line.
+int colour_registry_load(colour_registry_t *reg, const char *text);
+
+// Thresholds in class id order, for class_lut_update
+void colour_registry_thresholds(const colour_registry_t *reg, color_threshold_t *thresholds);
+
+// A kept blob with its raster key, so components that finish out of order
+// can still be kept in first-pixel order
+typedef struct
+{
+    int first;
+    blob_t blob;
+} ranked_blob_t;
+
+typedef struct
+{
+    int pixel_count;
+    float percent;
+    ranked_blob_t blobs[DETECT_MAX_BLOBS]; // first DETECT_MAX_BLOBS blobs in raster order
+    int blob_count;
+    int rejected_count; // components below min_pixels
+    int dropped_count;  // qualifying components that did not fit into blobs
+    bool detected;
+    int detected_blob; // index into blobs, -1 if not detected
+} class_result_t;
+
+// Per-class statistics of one frame, filled from the labeler in one sweep
+typedef struct
+{
+    int class_count;
+    int min_pixels;
+    bool gated; // skipped by the coverage gate, pixel counts are estimates
+    class_result_t classes[CLASS_LUT_MAX_CLASSES];
+} frame_result_t;
+
+void frame_result_reset(frame_result_t *result, int class_count, int min_pixels);
+
+// Adds one finished component to its class; has the blob_retire_fn signature
+// so it can be handed to a labeler in retire mode with the result as ctx
+void frame_result_add(void *result, const blob_label_stats_t *stats);
+
+// Adds every component of a labeler that is not in retire mode
+void frame_result_add_all(frame_result_t *result, blob_labeler_t *lab);
+
+// Coverage and blob checks per class, sets percent / detected / detected_blob
+void colour_detect_evaluate(const colour_registry_t *reg, frame_result_t *result, int total_pixels);
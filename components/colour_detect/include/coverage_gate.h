@@ -0,0 +1,44 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "class_lut.h"
+#include "colour_detect.h"
+
+// Cheap pre-filter in front of the pipelines. A fixed low-discrepancy set of
+// pixels (R2 sequence, so samples spread evenly over the frame) is
+// classified, and per class the Wilson score upper bound of the coverage is
+// taken at z standard deviations. When every class is below its min_percent
+// even at that bound, no class can be detected and the frame is skipped.
+//
+// The samples are deterministic rather than random, so the bound is a
+// confidence level in the usual sense only for scenes not aligned with the
+// sample pattern; in practice the even spread makes the estimate tighter
+// than random sampling.
+#define COVERAGE_GATE_DEFAULT_Z 3.0f
+
+typedef struct
+{
+    int width;
+    int height;
+    int sample_count;
+    float z;
+    uint32_t *samples; // y << 16 | x, in raster order
+
+    // frames seen and frames short-circuited since init
+    uint32_t frames;
+    uint32_t skipped;
+} coverage_gate_t;
+
+bool coverage_gate_init(coverage_gate_t *gate, int width, int height, int sample_count, float z);
+void coverage_gate_free(coverage_gate_t *gate);
+
+// Classifies the samples and returns true if the frame can be skipped. The
+// result must be freshly reset; on a skip its pixel counts are filled with
+// the scaled-up sample counts and result->gated is set, otherwise it is left
+// untouched for the full pass.
+bool coverage_gate_check(coverage_gate_t *gate, const colour_registry_t *reg, const class_lut_t *lut,
+                         const pixel_frame_t *frame, frame_result_t *result);
+
+// Upper confidence bound of a proportion, hits out of n, at z sigmas
+float coverage_gate_upper_bound(int hits, int n, float z);
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+// Bump allocator over one internal SRAM block and one PSRAM block, both
+// taken from the heap once. Buffers are carved out by MALLOC_CAP_SPIRAM in
+// caps like heap_caps_malloc and stay until the arena is destroyed; freeing
+// one is a no-op. A region that runs out spills to the heap, and the spill is
+// counted so a too small budget shows up.
+//
+// Every call also takes a NULL arena and then is plain heap_caps_*, so the
+// modules work the same with or without one.
+#define DETECT_ARENA_ALIGN 16
+
+typedef struct
+{
+    uint8_t *base;
+    size_t size;
+    size_t used;
+} detect_region_t;
+
+typedef struct
+{
+    detect_region_t internal;
+    detect_region_t psram;
+    size_t spilled_bytes; // served from the heap because a region was full
+    int spilled_count;
+} detect_arena_t;
+
+bool detect_arena_init(detect_arena_t *arena, size_t internal_bytes, size_t psram_bytes);
+void detect_arena_destroy(detect_arena_t *arena);
+
+void *detect_arena_alloc(detect_arena_t *arena, size_t size, uint32_t caps);
+void *detect_arena_calloc(detect_arena_t *arena, size_t n, size_t size, uint32_t caps);
+
+// Moves a block to a larger one; old_size bytes are kept. Arena blocks are
+// left behind, so growth should be rare and geometric.
+void *detect_arena_realloc(detect_arena_t *arena, void *ptr, size_t old_size, size_t size, uint32_t caps);
+
+// Frees heap blocks (including spills), ignores blocks of the arena
+void detect_arena_free(detect_arena_t *arena, void *ptr);
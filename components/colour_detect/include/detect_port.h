@@ -0,0 +1,71 @@
+#pragma once
+
+// The few ESP-IDF services the pipeline uses: logging, capability-based heap,
+// the microsecond timer and a fine-grained tick clock. On target these are the
+// IDF headers; on a Linux host they are stand-ins from detect_port_host.c so
+// the same sources build there.
+#ifdef ESP_PLATFORM
+#include "esp_log.h"
+#include "esp_heap_caps.h"
+#include "esp_timer.h"
+#include "esp_cpu.h"
+#include "esp_rom_sys.h"
+
+// Cycle counter of the calling core. Differences are only meaningful while
+// the task stays on one core, which holds for the pinned main task.
+static inline uint32_t port_ticks(void)
+{
+    return (uint32_t)esp_cpu_get_cycle_count();
+}
+
+static inline uint32_t port_ticks_per_us(void)
+{
+    return esp_rom_get_cpu_ticks_per_us();
+}
+#else
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+
+#define MALLOC_CAP_32BIT (1 << 1)
+#define MALLOC_CAP_8BIT (1 << 2)
+#define MALLOC_CAP_SPIRAM (1 << 10)
+#define MALLOC_CAP_INTERNAL (1 << 11)
+
+void *heap_caps_malloc(size_t size, uint32_t caps);
+void *heap_caps_calloc(size_t n, size_t size, uint32_t caps);
+void *heap_caps_realloc(void *ptr, size_t size, uint32_t caps);
+void heap_caps_free(void *ptr);
+size_t heap_caps_get_total_size(uint32_t caps);
+size_t heap_caps_get_free_size(uint32_t caps);
+size_t heap_caps_get_minimum_free_size(uint32_t caps); // since the last port_heap_reset_peak
+
+int64_t esp_timer_get_time(void);
+
+// Monotonic clock in nanoseconds, wrapping like the target cycle counter
+uint32_t port_ticks(void);
+
+static inline uint32_t port_ticks_per_us(void)
+{
+    return 1000;
+}
+
+#define ESP_LOGE(tag, fmt, ...) fprintf(stderr, "E %s: " fmt "\n", tag, ##__VA_ARGS__)
+#define ESP_LOGW(tag, fmt, ...) fprintf(stderr, "W %s: " fmt "\n", tag, ##__VA_ARGS__)
+#define ESP_LOGI(tag, fmt, ...) fprintf(stderr, "I %s: " fmt "\n", tag, ##__VA_ARGS__)
+#define ESP_LOGD(tag, fmt, ...) ((void)(tag))
+
+// Host heap accounting: allocations with MALLOC_CAP_SPIRAM count as PSRAM,
+// everything else as internal SRAM, against the ESP32-S3 budgets
+typedef struct
+{
+    size_t internal_in_use;
+    size_t internal_peak;
+    size_t psram_in_use;
+    size_t psram_peak;
+    size_t alloc_count; // malloc/calloc/realloc calls since the last reset
+} port_heap_stats_t;
+
+void port_heap_stats(port_heap_stats_t *stats);
+void port_heap_reset_peak(void); // peaks drop to the current usage, count to 0
+#endif
@@ -0,0 +1,122 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include "detect_port.h"
+#include "blob_label.h"
+
+// Per-frame instrumentation: stage timers on port_ticks (CPU cycles on
+// target, nanoseconds on the host), counters and peak heap use, written as
+// fixed-size records into a lock-free ring and printed after the frame, so
+// nothing is formatted or printed while a frame is processed.
+//
+// Every finished component can be recorded too, but only when built with
+// DETECT_PROF_BLOBS=1; otherwise DETECT_PROF_BLOB compiles to nothing.
+#ifndef DETECT_PROF_BLOBS
+#define DETECT_PROF_BLOBS 0
+#endif
+
+typedef enum
+{
+    DETECT_STAGE_GATE,
+    DETECT_STAGE_CLASSIFY,
+    DETECT_STAGE_LABEL, // classification included for the fused pipelines
+    DETECT_STAGE_EVALUATE,
+    DETECT_STAGE_FRAME,
+    DETECT_STAGE_COUNT
+} detect_stage_t;
+
+typedef enum
+{
+    DETECT_COUNT_PIXELS_CLASSIFIED,
+    DETECT_COUNT_BLOBS_FOUND,    // components of at least min_pixels
+    DETECT_COUNT_BLOBS_REJECTED, // components below min_pixels
+    DETECT_COUNT_COUNT
+} detect_counter_t;
+
+typedef enum
+{
+    DETECT_RECORD_STAGE,  // id: detect_stage_t, value: ticks
+    DETECT_RECORD_COUNT,  // id: detect_counter_t, value: count
+    DETECT_RECORD_MEMORY, // id: 0 internal / 1 PSRAM, value: peak bytes in use during the frame
+    DETECT_RECORD_BLOB,   // id: class id, value: pixel count, x / y: centre
+} detect_record_kind_t;
+
+typedef struct
+{
+    _Atomic uint32_t seq; // published once equal to the write position + 1
+    uint32_t frame;
+    uint8_t kind;
+    uint8_t id;
+    uint16_t accepted; // DETECT_RECORD_BLOB only, 1 if it reached min_pixels
+    uint32_t value;
+    uint16_t x;
+    uint16_t y;
+} detect_record_t;
+
+// Bounded multi-producer, single-consumer ring. Producers claim a slot with
+// a compare-and-swap and publish it through its seq; a full ring drops the
+// record and counts it rather than blocking the pipeline.
+typedef struct
+{
+    detect_record_t *records;
+    uint32_t capacity; // power of two
+    _Atomic uint32_t head;
+    _Atomic uint32_t tail;
+    _Atomic uint32_t dropped;
+    uint32_t frame;
+    // lowest free heap seen at the frame's stage boundaries, internal / PSRAM;
+    // only the thread running the frame touches it
+    size_t min_free[2];
+} detect_prof_t;
+
+typedef enum
+{
+    DETECT_PROF_LINES, // "prof frame 3 stage classify 1.234 ms"
+    DETECT_PROF_JSON,  // one JSON object per line
+} detect_prof_format_t;
+
+// A running stage timer, ended by detect_prof_end
+typedef struct
+{
+    detect_stage_t stage;
+    uint32_t start;
+} detect_prof_scope_t;
+
+// capacity is rounded up to a power of two
+bool detect_prof_init(detect_prof_t *prof, int capacity);
+void detect_prof_free(detect_prof_t *prof);
+
+// Starts the next frame; blob records go to prof until detect_prof_frame_end
+void detect_prof_frame_begin(detect_prof_t *prof);
+// Records peak heap use and stops collecting blob records. The peak is the
+// most in use at the frame's start, end and stage boundaries, the same on
+// target and host; allocations made and freed inside one stage are missed.
+void detect_prof_frame_end(detect_prof_t *prof);
+
+static inline detect_prof_scope_t detect_prof_begin(detect_stage_t stage)
+{
+    detect_prof_scope_t scope = {stage, port_ticks()};
+    return scope;
+}
+
+// Ends the scope, records it when prof is not NULL and returns the ticks
+uint32_t detect_prof_end(detect_prof_t *prof, const detect_prof_scope_t *scope);
+
+void detect_prof_count(detect_prof_t *prof, detect_counter_t counter, uint32_t value);
+
+// Prints and removes every published record, oldest first
+void detect_prof_dump(detect_prof_t *prof, detect_prof_format_t format);
+
+static inline int64_t detect_prof_us(uint32_t ticks)
+{
+    return ticks / port_ticks_per_us();
+}
+
+#if DETECT_PROF_BLOBS
+void detect_prof_blob(const blob_label_stats_t *stats, bool accepted);
+#define DETECT_PROF_BLOB(stats, accepted) detect_prof_blob(stats, accepted)
+#else
+#define DETECT_PROF_BLOB(stats, accepted) ((void)0)
+#endif
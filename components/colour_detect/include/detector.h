@@ -0,0 +1,108 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "class_lut.h"
+#include "colour_detect.h"
+#include "coverage_gate.h"
+#include "detect_prof.h"
+#include "detect_arena.h"
+#include "frame_parallel.h"
+#include "frame_stream.h"
+#include "frame_pyramid.h"
+#include "pixel_morph.h"
+#include "tiled_image.h"
+
+// How a frame is processed
+typedef enum
+{
+    DETECTOR_FULL_FRAME, // classify the whole frame into a class map, then label it
+    DETECTOR_PARALLEL,   // same, in one band per worker on all cores
+    DETECTOR_STREAMING,  // classify and label row by row, no full-frame map
+    DETECTOR_PYRAMID,    // decimated pass first, full resolution only around candidates
+    DETECTOR_MORPH,      // packed mask per class, gaps bridged by dilation, 8-connected labeling
+} detector_pipeline_t;
+
+typedef struct
+{
+    detector_pipeline_t pipeline;
+    int width;
+    int height;
+    int max_gap;
+    int min_pixels;
+    int workers;        // DETECTOR_PARALLEL only
+    int chunk_rows;     // DETECTOR_STREAMING only, rows per pushed chunk
+    int pyramid_factor; // DETECTOR_PYRAMID only, 4 or 8
+    int denoise_radius; // DETECTOR_MORPH only, opening against speckle before labeling, 0 off
+    coverage_gate_t *gate; // optional pre-filter, NULL processes every frame
+    detect_prof_t *prof;   // optional stage / counter records, NULL records nothing
+} detector_config_t;
+
+// Wall time of each stage of one frame in microseconds. The parallel,
+// streaming and pyramid pipelines classify and label in the same pass, so
+// their classify_us is 0 and label_us covers both. gate_us is the coverage
+// gate's sampling, the only stage of a skipped frame besides evaluate. All
+// are measured on port_ticks, the same clock as the profiler records.
+typedef struct
+{
+    int64_t gate_us;
+    int64_t classify_us;
+    int64_t label_us;
+    int64_t evaluate_us;
+    int64_t total_us;
+} detector_timing_t;
+
+// Arena sizes of a detector context
+typedef struct
+{
+    size_t internal_bytes; // row state, run rings and small label tables
+    size_t psram_bytes;    // class maps, stitching tables and grown label tables
+} detector_budget_t;
+
+// Working state of the configured pipeline, made once and reused for every
+// frame. Its buffers are carved from one arena; once the first frames have
+// grown the labelers' tables to the scene, a frame allocates nothing.
+typedef struct
+{
+    detector_config_t config;
+    detect_arena_t arena;
+    uint8_t *class_map;     // DETECTOR_FULL_FRAME and DETECTOR_PARALLEL
+    blob_labeler_t labeler; // DETECTOR_FULL_FRAME and DETECTOR_MORPH
+    // DETECTOR_MORPH: one mask per class and the bridged copy being labeled
+    pixel_mask_t masks[CLASS_LUT_MAX_CLASSES];
+    int mask_count;
+    pixel_mask_t bridged;
+    frame_parallel_t parallel;
+    frame_stream_t stream;
+    frame_pyramid_t pyramid;
+} detector_t;
+
+// What the configured pipeline takes up front plus room for its tables to
+// grow, for the classes of lut
+void detector_default_budget(const detector_config_t *cfg, const class_lut_t *lut, detector_budget_t *budget);
+
+// budget may be NULL for detector_default_budget. The gate and profiler of
+// cfg are used, not owned; the gate must be made for cfg's frame size.
+bool detector_init(detector_t *det, const detector_config_t *cfg, const class_lut_t *lut,
+                   const detector_budget_t *budget);
+void detector_free(detector_t *det);
+
+// Runs one frame through the pipeline and the per-class decision. The frame
+// may have any stride but must match the configured size and be in the
+// format lut was built for. timing may be NULL.
+bool detector_run(detector_t *det, const colour_registry_t *reg, const class_lut_t *lut,
+                  const pixel_frame_t *frame, frame_result_t *result, detector_timing_t *timing);
+
+// Same for a tiled image, classified tile by tile where it is mapped; needs
+// DETECTOR_FULL_FRAME. The coverage gate does not apply, background tiles
+// cost next to nothing anyway. stats may be NULL.
+bool detector_run_tiled(detector_t *det, const colour_registry_t *reg, const class_lut_t *lut,
+                        const tiled_image_t *image, frame_result_t *result, detector_timing_t *timing,
+                        tiled_image_stats_t *stats);
+
+// One-off frame: a context is made for the call and freed before it returns
+bool detector_process(const detector_config_t *cfg, const colour_registry_t *reg,
+                      const class_lut_t *lut, const pixel_frame_t *frame,
+                      frame_result_t *result, detector_timing_t *timing);
+
+const char *detector_pipeline_name(detector_pipeline_t pipeline);
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "pixel_format.h"
+#include "worker_pool.h"
+
+// A directory of raw frames run one after the other, for regression and
+// throughput runs over captured footage: the host file system, or an SD card
+// or SPIFFS partition mounted through the VFS on target. Every *.raw file
+// (any case, as FAT short names come upper case) is a packed frame of the
+// corpus format and size; files of another size are skipped with a warning.
+// Frames come in name order.
+//
+// With prefetch an I/O thread (a one-worker pool) reads frame N + 1 into the
+// second of two buffers while frame N is processed, so the detector only
+// waits for storage when reading is slower than detecting. Both buffers and
+// the name list are made once at open; nothing is allocated per frame.
+#define FRAME_CORPUS_NAME_LEN 64
+#define FRAME_CORPUS_PATH_LEN 128
+// Stack of the I/O task: fopen / fread through the VFS, and FATFS with long
+// file names keeps its name buffers on the stack
+#define FRAME_CORPUS_IO_STACK 16384
+
+typedef struct
+{
+    char dir[FRAME_CORPUS_PATH_LEN];
+    char (*names)[FRAME_CORPUS_NAME_LEN];
+    int count;
+    pixel_format_t format;
+    int width;
+    int height;
+    size_t frame_bytes;
+    bool prefetch;
+
+    uint8_t *buffers[2];
+    int back;     // buffer the loader fills
+    int cursor;   // next name the loader tries
+    int loaded;   // name index of the frame in the back buffer, -1 at the end
+    bool pending; // a load runs on the I/O thread
+    bool unrecorded; // the frame last handed out has no outcome yet
+    worker_pool_t io;
+
+    // since open
+    int frames;         // processed, see frame_corpus_record
+    int errors;         // the caller failed to process, see frame_corpus_fail
+    int failed;         // files skipped by the loader
+    int64_t load_us;    // spent reading, on whichever thread
+    int64_t wait_us;    // frame_corpus_next blocked on the loader
+    int64_t start_us;
+    int64_t end_us;     // the last frame_corpus_next
+    int64_t *latency_us; // one per processed frame
+} frame_corpus_t;
+
+typedef struct
+{
+    int frames;
+    int errors;
+    int failed;
+    double fps;     // frames over the wall time since open, storage stalls included
+    int64_t p50_us; // frame latency percentiles, nearest rank
+    int64_t p90_us;
+    int64_t p99_us;
+    int64_t max_us;
+    int64_t load_us;
+    int64_t wait_us;
+} frame_corpus_summary_t;
+
+// Lists dir and starts loading the first frame. Buffers come from caps,
+// e.g. MALLOC_CAP_SPIRAM for full frames on target.
+bool frame_corpus_open(frame_corpus_t *corpus, const char *dir, pixel_format_t format, int width, int height,
+                       uint32_t caps, bool prefetch);
+void frame_corpus_close(frame_corpus_t *corpus);
+
+// The next frame and its file name, both valid until the following call;
+// false once the corpus is exhausted
+bool frame_corpus_next(frame_corpus_t *corpus, pixel_frame_t *frame, const char **name);
+
+// Outcome of the frame last returned by frame_corpus_next: its processing
+// time, or that processing failed. Only recorded frames count towards the
+// frames, throughput and latencies of the summary; failed ones are errors.
+void frame_corpus_record(frame_corpus_t *corpus, int64_t latency_us);
+void frame_corpus_fail(frame_corpus_t *corpus);
+
+// Throughput and latency so far; sorts the recorded latencies, so call it last
+void frame_corpus_summarize(frame_corpus_t *corpus, frame_corpus_summary_t *summary);
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "class_lut.h"
+#include "blob_label.h"
+#include "colour_detect.h"
+#include "worker_pool.h"
+
+// One horizontal band of the frame, classified and labeled by one worker
+typedef struct
+{
+    const pixel_frame_t *frame;
+    const class_lut_t *lut;
+    uint8_t *class_map;
+    int y0;
+    int y1; // exclusive
+    bool ok;
+    blob_labeler_t labeler;
+} frame_band_t;
+
+// Splits the frame into one band per worker, then stitches blobs that reach
+// across band boundaries. Each band must be at least max_gap rows tall so
+// that only neighbouring bands can share a blob.
+typedef struct
+{
+    int width;
+    int height;
+    int max_gap;
+    int band_count;
+    worker_pool_t pool;
+    frame_band_t bands[WORKER_POOL_MAX];
+
+    // all band labels concatenated, re-rooted after stitching
+    blob_label_stats_t *merged;
+    int merged_count;
+    int merged_capacity;
+
+    detect_arena_t *arena;
+} frame_parallel_t;
+
+// arena may be NULL to allocate from the heap; the workers' own stacks and
+// semaphores always come from the system
+bool frame_parallel_init(frame_parallel_t *fp, int width, int height, int max_gap, int workers,
+                         detect_arena_t *arena);
+void frame_parallel_free(frame_parallel_t *fp);
+
+// Classifies the frame into class_map (one class id per pixel) and labels
+// every class in the same sweep. The stitched components are added to result
+// in raster order, identical to a single labeler run over the whole map.
+bool frame_parallel_process(frame_parallel_t *fp, const pixel_frame_t *frame, const class_lut_t *lut,
+                            uint8_t *class_map, frame_result_t *result);
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "class_lut.h"
+#include "blob_label.h"
+#include "colour_detect.h"
+
+// Coarse-to-fine pipeline for mostly-background frames. One pixel per
+// factor x factor cell is classified and labeled first; only padded boxes
+// around the coarse candidates are then classified and labeled at full
+// resolution, so a sparse frame costs about 1/factor^2 of a full pass.
+//
+// Tolerance against the full-resolution pipelines:
+// - every blob whose coarse component has at least coarse_min samples is
+//   reported identically (count, centre, bounds, raster order): a box is
+//   grown by pad = factor + max_gap on any side a kept blob comes within
+//   max_gap of, until no kept blob can continue outside its box
+// - blobs that are thinner than factor pixels in both directions, or small
+//   enough to yield fewer than coarse_min samples, can be missed
+// - class pixel counts outside the boxes are estimated as factor^2 per
+//   sample, so percent is approximate there (noise pixels mostly) and
+//   rejected_count only covers components inside the boxes
+// - when the boxes would exceed FRAME_PYRAMID_MAX_ROIS, cover more than
+//   FRAME_PYRAMID_MAX_ROI_SHARE of the frame or still grow after
+//   FRAME_PYRAMID_MAX_GROWS rounds, the frame is labeled at full resolution
+//   and the result is exact
+#define FRAME_PYRAMID_MAX_ROIS 64
+#define FRAME_PYRAMID_MAX_ROI_SHARE 0.5f
+#define FRAME_PYRAMID_MAX_GROWS 4
+
+// Full-resolution box, bounds inclusive
+typedef struct
+{
+    int x0;
+    int y0;
+    int x1;
+    int y1;
+} frame_roi_t;
+
+typedef struct
+{
+    int width;
+    int height;
+    int max_gap;
+    int min_pixels;
+    int factor;     // decimation, 4 or 8
+    int pad;        // pixels added around each candidate's sampled cells
+    int coarse_min; // samples a coarse component needs to become a candidate
+
+    int coarse_width;
+    int coarse_height;
+    uint8_t *coarse_map; // one class id per cell
+    uint8_t *class_row;  // full-resolution row of the box being refined
+    blob_labeler_t coarse_labeler;
+    blob_labeler_t roi_labeler; // narrowed to each box in turn
+    detect_arena_t *arena;
+
+    frame_roi_t rois[FRAME_PYRAMID_MAX_ROIS];
+    int roi_count;
+
+    // last frame: pixels classified at full resolution, and whether the
+    // frame was too dense for the coarse pass to pay off
+    int refined_pixels;
+    bool full_frame;
+} frame_pyramid_t;
+
+// arena may be NULL to allocate from the heap
+bool frame_pyramid_init(frame_pyramid_t *fp, int width, int height, int max_gap,
+                        int min_pixels, int factor, detect_arena_t *arena);
+void frame_pyramid_free(frame_pyramid_t *fp);
+
+// Resets result and fills it for one frame
+bool frame_pyramid_process(frame_pyramid_t *fp, const pixel_frame_t *frame, const class_lut_t *lut,
+                           frame_result_t *result);
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "class_lut.h"
+#include "blob_label.h"
+#include "colour_detect.h"
+
+// Streaming pipeline: rows are classified and labeled as they arrive (e.g. a
+// camera DMA chunk at a time), so there are no full-frame masks. The only
+// state is one row of class ids plus the labeler's run ring and open
+// components, all in internal SRAM. Every class is labeled in the same sweep.
+typedef struct
+{
+    int width;
+    int height;
+    int y;
+    const class_lut_t *lut; // may be swapped between frames
+    uint8_t *class_row;
+    blob_labeler_t labeler;
+    frame_result_t result;
+    detect_arena_t *arena;
+} frame_stream_t;
+
+// arena may be NULL to allocate from the heap
+bool frame_stream_init(frame_stream_t *fs, int width, int height, int max_gap,
+                       int min_pixels, const class_lut_t *lut, detect_arena_t *arena);
+void frame_stream_free(frame_stream_t *fs);
+
+// Start a new frame
+void frame_stream_begin(frame_stream_t *fs);
+
+// Classify and label the next row_count rows, stride bytes apart and in the
+// format of fs->lut; the last row of the frame also closes every open blob,
+// so fs->result is final when this returns
+bool frame_stream_push_rows(frame_stream_t *fs, const uint8_t *rows, int stride, int row_count);
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "class_lut.h"
+#include "blob_label.h"
+#include "colour_detect.h"
+#include "detect_arena.h"
+
+// Multi-frame mode for a mostly static scene. The frame is split into tiles
+// and a tile is only reclassified when enough of its pixels changed since it
+// was last classified; only the rows it covers get their runs re-extracted.
+// Labeling then works from the cached runs of every row, so a frame costs the
+// tile comparison plus O(changed pixels + runs) instead of a classification
+// of every pixel. A frame without a dirty tile keeps the previous result.
+//
+// With pixel_tolerance 0 and tile_threshold 0 every change is picked up and
+// the result equals the full-frame pipeline. Larger values ignore sensor
+// noise, at the price of stale classifications in tiles that changed less.
+typedef struct
+{
+    int tile_size;       // tile side in pixels
+    int pixel_tolerance; // per-channel RGB565 difference a pixel may drift by unnoticed
+    int tile_threshold;  // changed pixels a tile may have before it is reclassified
+} frame_temporal_config_t;
+
+// Cached runs of one row of the class map
+typedef struct
+{
+    blob_run_t *runs;
+    int count;
+    int capacity;
+} temporal_row_t;
+
+typedef struct
+{
+    int width;
+    int height;
+    frame_temporal_config_t config;
+    int tiles_x;
+    int tiles_y;
+
+    uint16_t *reference;   // pixels each tile was last classified from
+    uint8_t *class_map;    // one class id per pixel, kept between frames
+    uint8_t *dirty_rows;   // rows whose runs need re-extracting
+    temporal_row_t *rows;  // runs of every row of class_map
+    blob_run_t *run_block; // the rows' first runs, until a row outgrows its share
+    blob_labeler_t labeler; // retire mode into result
+    frame_result_t result;
+    bool primed;           // class_map matches reference
+
+    // last frame
+    int dirty_tiles;
+    bool relabeled;
+    detect_arena_t *arena;
+} frame_temporal_t;
+
+// arena may be NULL to allocate from the heap
+bool frame_temporal_init(frame_temporal_t *ft, int width, int height, int max_gap, int min_pixels,
+                         const frame_temporal_config_t *config, detect_arena_t *arena);
+void frame_temporal_free(frame_temporal_t *ft);
+
+// Forget the cached classification; the next frame is processed in full.
+// Call it whenever the class table changed: the cache is not checked against
+// the table, unchanged tiles keep the ids the old one gave them.
+void frame_temporal_invalidate(frame_temporal_t *ft);
+
+// Processes the next frame of the sequence. ft->result holds the per-class
+// statistics, ready for colour_detect_evaluate. The tile comparison works on
+// RGB565 channels, so pixels are packed RGB565 and lut an RGB565 table.
+bool frame_temporal_process(frame_temporal_t *ft, const uint16_t *pixels, const class_lut_t *lut);
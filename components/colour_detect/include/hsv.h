@@ -0,0 +1,27 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// HSV color structure
+typedef struct
+{
+    uint8_t h; // Hue (0-180)
+    uint8_t s; // Saturation (0-255)
+    uint8_t v; // Value (0-255)
+} hsv_t;
+
+// Color threshold structure
+typedef struct
+{
+    uint8_t h_min;
+    uint8_t h_max;
+    uint8_t s_min;
+    uint8_t s_max;
+    uint8_t v_min;
+    uint8_t v_max;
+} color_threshold_t;
+
+// Scalar reference path: everything faster must agree with these two
+hsv_t rgb565_to_hsv(uint16_t rgb565);
+bool matches_threshold(hsv_t hsv, color_threshold_t thresh);
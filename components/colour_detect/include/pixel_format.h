@@ -0,0 +1,82 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+// Pixel layouts the classifier reads natively. Every format maps a pixel to
+// a 16-bit index into its own class table, so no format is converted to
+// RGB565 or HSV on the way: the thresholds are compiled into the table of the
+// format instead.
+typedef enum
+{
+    PIXEL_FORMAT_RGB565,    // 16-bit words in CPU (little-endian) order
+    PIXEL_FORMAT_RGB565_BE, // byte-swapped RGB565, high byte first, as most camera sensors send it
+    PIXEL_FORMAT_RGB888,    // R, G, B bytes; the index keeps the top 5 / 6 / 5 bits
+    PIXEL_FORMAT_YUV422,    // Y0 U Y1 V, one U / V pair per two pixels; the index keeps 6 / 5 / 5 bits
+    PIXEL_FORMAT_COUNT
+} pixel_format_t;
+
+// A frame in any format, with its geometry known only at runtime
+typedef struct
+{
+    const uint8_t *data;
+    pixel_format_t format;
+    int width;
+    int height;
+    int stride; // bytes from one row to the next, at least width * bytes per pixel
+} pixel_frame_t;
+
+// Bytes per pixel, averaged over a pair for YUV422
+int pixel_format_bytes(pixel_format_t format);
+const char *pixel_format_name(pixel_format_t format);
+bool pixel_format_parse(const char *name, pixel_format_t *format);
+
+// stride 0 means rows are packed. False if the stride is too short or breaks
+// the 16-bit alignment of the RGB565 formats.
+bool pixel_frame_wrap(pixel_frame_t *frame, const void *data, pixel_format_t format, int width, int height,
+                      int stride);
+
+static inline const uint8_t *pixel_frame_row(const pixel_frame_t *frame, int y)
+{
+    return frame->data + (size_t)y * frame->stride;
+}
+
+// The RGB565 colour one table index stands for, for building the class
+// table of a format; YUV422 entries are the BT.601 full-range colour at the
+// centre of the index's bin
+uint16_t pixel_format_index_colour(pixel_format_t format, uint16_t index);
+
+static inline uint16_t pixel_index_rgb888(const uint8_t *p)
+{
+    return (uint16_t)((p[0] >> 3) << 11 | (p[1] >> 2) << 5 | p[2] >> 3);
+}
+
+static inline uint16_t pixel_index_yuv(uint8_t y, uint16_t uv)
+{
+    return (uint16_t)((y >> 2) << 10 | uv);
+}
+
+// U and V of a pixel pair, the low 10 bits of the pair's indices
+static inline uint16_t pixel_index_uv(uint8_t u, uint8_t v)
+{
+    return (uint16_t)((u >> 3) << 5 | v >> 3);
+}
+
+// Table index of pixel x of a row; for sparse reads, whole rows go through
+// class_lut_classify_ids
+static inline uint16_t pixel_format_index(pixel_format_t format, const uint8_t *row, int x)
+{
+    switch (format)
+    {
+    case PIXEL_FORMAT_RGB888:
+        return pixel_index_rgb888(row + 3 * x);
+    case PIXEL_FORMAT_YUV422:
+    {
+        const uint8_t *pair = row + 4 * (x >> 1);
+        return pixel_index_yuv(pair[2 * (x & 1)], pixel_index_uv(pair[1], pair[3]));
+    }
+    default:
+        return ((const uint16_t *)row)[x];
+    }
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "detect_arena.h"
+
+// 1 bit per pixel, LSB first: pixel x of a row lives in bit (x % 32) of word (x / 32).
+// Rows are padded to whole words so every row starts word aligned and the
+// padding bits are always zero.
+#define PIXEL_MASK_WORD_BITS 32
+
+typedef struct
+{
+    uint32_t *words;
+    int width;
+    int height;
+    int words_per_row;
+    detect_arena_t *arena; // where the words live, NULL for the heap
+} pixel_mask_t;
+
+bool pixel_mask_init(pixel_mask_t *mask, int width, int height, uint32_t caps);
+bool pixel_mask_init_in(pixel_mask_t *mask, int width, int height, uint32_t caps, detect_arena_t *arena);
+void pixel_mask_free(pixel_mask_t *mask);
+void pixel_mask_clear(pixel_mask_t *mask);
+
+// Number of set pixels in one row / in the whole mask
+int pixel_mask_row_popcount(const pixel_mask_t *mask, int y);
+size_t pixel_mask_popcount(const pixel_mask_t *mask);
+
+// First set pixel in row y at or after x, or -1 if there is none
+int pixel_mask_row_next(const pixel_mask_t *mask, int y, int x);
+
+static inline uint32_t *pixel_mask_row(const pixel_mask_t *mask, int y)
+{
+    return mask->words + (size_t)y * mask->words_per_row;
+}
+
+// Word-at-a-time store, used by the classifier to write 32 pixels at once
+static inline void pixel_mask_store_word(pixel_mask_t *mask, int y, int word, uint32_t bits)
+{
+    pixel_mask_row(mask, y)[word] = bits;
+}
+
+static inline void pixel_mask_set(pixel_mask_t *mask, int x, int y)
+{
+    pixel_mask_row(mask, y)[x / PIXEL_MASK_WORD_BITS] |= 1u << (x % PIXEL_MASK_WORD_BITS);
+}
+
+static inline bool pixel_mask_test(const pixel_mask_t *mask, int x, int y)
+{
+    return (pixel_mask_row(mask, y)[x / PIXEL_MASK_WORD_BITS] >> (x % PIXEL_MASK_WORD_BITS)) & 1u;
+}
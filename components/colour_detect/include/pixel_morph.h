@@ -0,0 +1,45 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "pixel_mask.h"
+
+// Binary morphology on packed masks, 32 pixels per operation: the
+// horizontal pass ORs (ANDs) word-shifted copies of a row, the vertical pass
+// ORs (ANDs) whole rows. Outside the frame counts as background for dilation
+// and is ignored by erosion, so blobs touching the border are not eaten.
+//
+// A box reaches left / right pixels and up / down rows from its centre, at
+// most PIXEL_MORPH_MAX_REACH each.
+#define PIXEL_MORPH_MAX_REACH 31
+// Largest max_gap whose gap box fits those reaches
+#define PIXEL_MORPH_MAX_GAP (2 * PIXEL_MORPH_MAX_REACH + 1)
+
+typedef struct
+{
+    int left;
+    int right;
+    int up;
+    int down;
+} pixel_morph_box_t;
+
+// The box of side max_gap. Dilating by it turns "at most max_gap apart in x
+// and y" into plain 8-connectivity: two pixels are that close exactly when
+// their boxes overlap or touch. Only exact up to PIXEL_MORPH_MAX_GAP, beyond
+// that the reaches are capped and less is bridged.
+pixel_morph_box_t pixel_morph_gap_box(int max_gap);
+
+// dst must be a different mask of the same size as src. Dilation sets every
+// pixel of the box around each set pixel, erosion keeps the pixels whose
+// whole box is set, so erode then dilate by the same box is an opening.
+void pixel_morph_dilate_box(const pixel_mask_t *src, pixel_mask_t *dst, pixel_morph_box_t box);
+void pixel_morph_erode_box(const pixel_mask_t *src, pixel_mask_t *dst, pixel_morph_box_t box);
+
+// Square of side 2 * radius + 1
+void pixel_morph_dilate(const pixel_mask_t *src, pixel_mask_t *dst, int radius);
+void pixel_morph_erode(const pixel_mask_t *src, pixel_mask_t *dst, int radius);
+
+// In place on mask, tmp is scratch of the same size. Opening removes
+// speckle smaller than the square, closing fills holes and cracks.
+void pixel_morph_open(pixel_mask_t *mask, pixel_mask_t *tmp, int radius);
+void pixel_morph_close(pixel_mask_t *mask, pixel_mask_t *tmp, int radius);
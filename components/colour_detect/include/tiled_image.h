@@ -0,0 +1,108 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "pixel_format.h"
+#include "class_lut.h"
+
+// Flash-resident images as written by png2RGB565.py --tiled: a header, a
+// tile directory and the tiles, each starting on a TILED_IMAGE_ALIGN
+// boundary so a tile's rows are read through the flash cache in place. A
+// tile is stored raw (rows of the tile's width, classified straight from
+// flash), run-length coded, or as one repeated unit when it is uniform.
+// Several images follow one another in a pack, each aligned, so one data
+// partition holds a whole reference set.
+//
+// A unit is a pixel, or a Y0 U Y1 V pair for YUV422, whose tile widths are
+// even. All fields are little endian.
+#define TILED_IMAGE_MAGIC "CDTI"
+#define TILED_IMAGE_VERSION 1
+#define TILED_IMAGE_ALIGN 32
+#define TILED_IMAGE_NAME_LEN 16
+
+typedef enum
+{
+    TILED_TILE_RAW,     // unit rows, tile width * bytes per pixel each
+    TILED_TILE_RLE,     // records of a uint16_t unit count and one unit, in raster order
+    TILED_TILE_UNIFORM, // one unit that fills the whole tile
+} tiled_tile_encoding_t;
+
+typedef struct
+{
+    char magic[4];
+    uint16_t version;
+    uint8_t format; // pixel_format_t
+    uint8_t reserved;
+    uint16_t width;
+    uint16_t height;
+    uint16_t tile_width;
+    uint16_t tile_height;
+    uint32_t tile_count; // tiles_x * tiles_y, row-major
+    uint32_t total_size; // header, directory and tiles; the next image of a pack starts aligned after it
+    char name[TILED_IMAGE_NAME_LEN];
+} tiled_image_header_t;
+
+typedef struct
+{
+    uint32_t offset; // from the start of the image
+    uint32_t size;
+    uint8_t encoding; // tiled_tile_encoding_t
+    uint8_t reserved[3];
+} tiled_image_entry_t;
+
+// One image of a mapped pack; points into the mapping, nothing is copied
+typedef struct
+{
+    const uint8_t *base;
+    const tiled_image_header_t *header;
+    const tiled_image_entry_t *tiles;
+    pixel_format_t format;
+    int width;
+    int height;
+    int tiles_x;
+    int tiles_y;
+} tiled_image_t;
+
+// Read-only mapping of a pack: a data partition on target (esp_partition_mmap),
+// a file on the host (mmap)
+typedef struct
+{
+    const uint8_t *data;
+    size_t size;
+    uint32_t handle; // esp_partition_mmap handle, target only
+} tiled_pack_t;
+
+// name is the partition label on target, the file path on the host
+bool tiled_pack_map(tiled_pack_t *pack, const char *name);
+void tiled_pack_unmap(tiled_pack_t *pack);
+
+// Validates the image at *offset of a pack and moves *offset to the next
+// one. Returns false at the end of the pack or on a malformed image.
+bool tiled_pack_next(const tiled_pack_t *pack, size_t *offset, tiled_image_t *image);
+
+// Validates one image of size bytes
+bool tiled_image_open(tiled_image_t *image, const void *data, size_t size);
+
+// Pixel bounds of tile t
+void tiled_image_tile_rect(const tiled_image_t *image, int t, int *x0, int *y0, int *width, int *height);
+
+// A raw tile as a frame of its own, still in flash; false for other encodings
+bool tiled_image_tile_frame(const tiled_image_t *image, int t, pixel_frame_t *frame);
+
+typedef struct
+{
+    int raw_tiles;
+    int rle_tiles;
+    int uniform_tiles;
+    int skipped_tiles;          // uniform tiles of no class, only cleared
+    uint32_t classified_pixels; // table lookups; runs and uniform tiles take one per unit
+} tiled_image_stats_t;
+
+// Classifies the whole image into a class map of width bytes per row. Raw
+// tiles are classified in place, runs and uniform tiles once per unit.
+void tiled_image_classify(const tiled_image_t *image, const class_lut_t *lut, uint8_t *class_map,
+                          tiled_image_stats_t *stats);
+
+// Expands the image into frame-order rows of stride bytes
+void tiled_image_decode(const tiled_image_t *image, uint8_t *pixels, int stride);
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// Fixed set of worker threads that all run the same job on their own argument.
+// FreeRTOS tasks pinned round-robin to the cores on target, pthreads on the host.
+#define WORKER_POOL_MAX 8
+// Band jobs classify and label rows with their scratch in the labeler, not
+// on the stack, but still call into logging; 8 KB leaves headroom for that
+#define WORKER_POOL_DEFAULT_STACK 8192
+
+typedef void (*worker_job_fn)(void *arg);
+
+typedef struct worker_pool worker_pool_t;
+
+typedef struct
+{
+    worker_pool_t *pool;
+    int index;
+} worker_slot_t;
+
+struct worker_pool
+{
+    int count;
+    bool stopping;
+    worker_job_fn job;
+    char *job_args;
+    size_t job_arg_stride;
+    worker_slot_t slots[WORKER_POOL_MAX];
+    void *threads[WORKER_POOL_MAX];
+    void *start[WORKER_POOL_MAX]; // one wake-up semaphore per worker
+    void *done;                   // given once by each worker per job
+    size_t stack_size;            // bytes per FreeRTOS task; host threads keep the pthread default
+};
+
+bool worker_pool_init(worker_pool_t *pool, int count, size_t stack_size);
+void worker_pool_free(worker_pool_t *pool);
+
+// Worker i runs job(args + i * arg_stride); returns once all of them finished
+void worker_pool_run(worker_pool_t *pool, worker_job_fn job, void *args, size_t arg_stride);
+
+// worker_pool_run in two halves, so the caller works while the job runs;
+// every worker_pool_start is followed by exactly one worker_pool_wait
+void worker_pool_start(worker_pool_t *pool, worker_job_fn job, void *args, size_t arg_stride);
+void worker_pool_wait(worker_pool_t *pool);
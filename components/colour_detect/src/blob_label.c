@@ -0,0 +1,693 @@
+#include <limits.h>
+#include <string.h>
+#include "detect_port.h"
+#include "blob_label.h"
+
+static const char *TAG = "blob_label";
+
+// Both tables start small and grow on demand; labels move from internal SRAM
+// to PSRAM once they outgrow LABEL_INTERNAL_BYTES
+#define LABEL_INITIAL_CAPACITY 64
+#define LABEL_INTERNAL_BYTES (16 * 1024)
+#define RUN_INITIAL_CAPACITY 64
+
+#define INTERNAL_CAPS (MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT)
+
+bool blob_labeler_init(blob_labeler_t *lab, int width, int height, int max_gap)
+{
+    return blob_labeler_init_in(lab, width, height, max_gap, NULL);
+}
+
+bool blob_labeler_init_in(blob_labeler_t *lab, int width, int height, int max_gap, detect_arena_t *arena)
+{
+    memset(lab, 0, sizeof(*lab));
+    // a gap of 1 merges touching runs only; below that there is no ring
+    if (max_gap < 1)
+    {
+        ESP_LOGE(TAG, "Gap of %d rows, need at least 1!", max_gap);
+        return false;
+    }
+    lab->arena = arena;
+    lab->width = width;
+    lab->height = height;
+    lab->max_gap = max_gap;
+    lab->ring_rows = max_gap + 1;
+    lab->free_label = -1;
+    // worst case is alternating set/clear pixels
+    lab->row_capacity = (width + 1) / 2 < RUN_INITIAL_CAPACITY ? (width + 1) / 2 : RUN_INITIAL_CAPACITY;
+
+    // run ring and row counts are touched for every run, keep them in internal SRAM
+    lab->runs = (blob_run_t *)detect_arena_alloc(arena, (size_t)lab->ring_rows * lab->row_capacity * sizeof(blob_run_t),
+                                                 INTERNAL_CAPS);
+    lab->row_run_count = (int *)detect_arena_alloc(arena, lab->ring_rows * sizeof(int), INTERNAL_CAPS);
+    lab->scan = (int *)detect_arena_alloc(arena, lab->ring_rows * sizeof(int), INTERNAL_CAPS);
+    lab->last = (int *)detect_arena_alloc(arena, BLOB_CLASS_IDS * sizeof(int), INTERNAL_CAPS);
+    lab->label_capacity = LABEL_INITIAL_CAPACITY;
+    lab->labels = (blob_label_stats_t *)detect_arena_alloc(arena, lab->label_capacity * sizeof(blob_label_stats_t),
+                                                           INTERNAL_CAPS);
+    if (lab->runs == NULL || lab->row_run_count == NULL || lab->scan == NULL || lab->last == NULL ||
+        lab->labels == NULL)
+    {
+        ESP_LOGE(TAG, "Failed to allocate labeler state!");
+        blob_labeler_free(lab);
+        return false;
+    }
+
+    blob_labeler_reset(lab, 0);
+    return true;
+}
+
+bool blob_labeler_keep_head(blob_labeler_t *lab)
+{
+    // only read when stitching, PSRAM is fine
+    lab->head_capacity = (lab->width + 1) / 2;
+    lab->head_runs = (blob_run_t *)detect_arena_alloc(lab->arena,
+                                                      (size_t)lab->max_gap * lab->head_capacity * sizeof(blob_run_t),
+                                                      MALLOC_CAP_SPIRAM);
+    lab->head_run_count = (int *)detect_arena_calloc(lab->arena, lab->max_gap, sizeof(int), MALLOC_CAP_SPIRAM);
+    if (lab->head_runs == NULL || lab->head_run_count == NULL)
+    {
+        ESP_LOGE(TAG, "Failed to allocate head rows!");
+        return false;
+    }
+    return true;
+}
+
+bool blob_labeler_set_retire(blob_labeler_t *lab, blob_retire_fn retire, void *ctx)
+{
+    if (lab->active == NULL)
+        lab->active = (int *)detect_arena_alloc(lab->arena, lab->label_capacity * sizeof(int), INTERNAL_CAPS);
+    if (lab->active == NULL)
+    {
+        ESP_LOGE(TAG, "Failed to allocate active label list!");
+        return false;
+    }
+    lab->retire = retire;
+    lab->retire_ctx = ctx;
+    return true;
+}
+
+void blob_labeler_reset(blob_labeler_t *lab, int first_row)
+{
+    lab->first_row = first_row;
+    lab->y = first_row;
+    lab->label_count = 0;
+    lab->active_count = 0;
+    lab->free_label = -1;
+    memset(lab->row_run_count, 0, lab->ring_rows * sizeof(int));
+    if (lab->head_run_count != NULL)
+        memset(lab->head_run_count, 0, lab->max_gap * sizeof(int));
+}
+
+void blob_labeler_free(blob_labeler_t *lab)
+{
+    detect_arena_free(lab->arena, lab->runs);
+    detect_arena_free(lab->arena, lab->row_run_count);
+    detect_arena_free(lab->arena, lab->scan);
+    detect_arena_free(lab->arena, lab->last);
+    detect_arena_free(lab->arena, lab->labels);
+    detect_arena_free(lab->arena, lab->head_runs);
+    detect_arena_free(lab->arena, lab->head_run_count);
+    detect_arena_free(lab->arena, lab->active);
+    lab->head_runs = NULL;
+    lab->head_run_count = NULL;
+    lab->runs = NULL;
+    lab->row_run_count = NULL;
+    lab->scan = NULL;
+    lab->last = NULL;
+    lab->labels = NULL;
+    lab->active = NULL;
+}
+
+void blob_labeler_set_width(blob_labeler_t *lab, int width)
+{
+    lab->width = width;
+}
+
+const blob_run_t *blob_labeler_row_runs(const blob_labeler_t *lab, int y, int *count)
+{
+    if (y >= lab->y - lab->ring_rows && y >= lab->first_row && y < lab->y)
+    {
+        int slot = y % lab->ring_rows;
+        *count = lab->row_run_count[slot];
+        return lab->runs + (size_t)slot * lab->row_capacity;
+    }
+    if (lab->head_runs != NULL && y >= lab->first_row && y < lab->first_row + lab->max_gap && y < lab->y)
+    {
+        int row = y - lab->first_row;
+        *count = lab->head_run_count[row];
+        return lab->head_runs + (size_t)row * lab->head_capacity;
+    }
+    *count = 0;
+    return NULL;
+}
+
+int blob_label_find(blob_label_stats_t *labels, int label)
+{
+    while (labels[label].parent != label)
+    {
+        // path halving
+        labels[label].parent = labels[labels[label].parent].parent;
+        label = labels[label].parent;
+    }
+    return label;
+}
+
+int blob_label_union(blob_label_stats_t *labels, int a, int b)
+{
+    a = blob_label_find(labels, a);
+    b = blob_label_find(labels, b);
+    if (a == b)
+        return a;
+    if (b < a)
+    {
+        int tmp = a;
+        a = b;
+        b = tmp;
+    }
+
+    blob_label_stats_t *root = &labels[a];
+    blob_label_stats_t *child = &labels[b];
+    root->pixel_count += child->pixel_count;
+    root->sum_x += child->sum_x;
+    root->sum_y += child->sum_y;
+    if (child->first < root->first)
+        root->first = child->first;
+    if (child->min_x < root->min_x)
+        root->min_x = child->min_x;
+    if (child->max_x > root->max_x)
+        root->max_x = child->max_x;
+    if (child->min_y < root->min_y)
+        root->min_y = child->min_y;
+    if (child->max_y > root->max_y)
+        root->max_y = child->max_y;
+    child->parent = a;
+    return a;
+}
+
+static bool grow_labels(blob_labeler_t *lab)
+{
+    int capacity = lab->label_capacity * 2;
+    size_t bytes = capacity * sizeof(blob_label_stats_t);
+    uint32_t caps = bytes > LABEL_INTERNAL_BYTES ? MALLOC_CAP_SPIRAM : INTERNAL_CAPS;
+
+    blob_label_stats_t *grown = (blob_label_stats_t *)detect_arena_realloc(
+        lab->arena, lab->labels, lab->label_capacity * sizeof(blob_label_stats_t), bytes, caps);
+    if (grown == NULL)
+    {
+        ESP_LOGE(TAG, "Failed to grow label table to %d entries!", capacity);
+        return false;
+    }
+    lab->labels = grown;
+
+    if (lab->active != NULL)
+    {
+        int *active = (int *)detect_arena_realloc(lab->arena, lab->active, lab->label_capacity * sizeof(int),
+                                                  capacity * sizeof(int), INTERNAL_CAPS);
+        if (active == NULL)
+        {
+            ESP_LOGE(TAG, "Failed to grow active label list to %d entries!", capacity);
+            return false;
+        }
+        lab->active = active;
+    }
+    lab->label_capacity = capacity;
+    return true;
+}
+
+static int new_label(blob_labeler_t *lab, int first, int class_id)
+{
+    int label;
+    if (lab->free_label >= 0)
+    {
+        label = lab->free_label;
+        lab->free_label = lab->labels[label].parent;
+    }
+    else
+    {
+        if (lab->label_count == lab->label_capacity && !grow_labels(lab))
+            return -1;
+        label = lab->label_count++;
+    }
+    if (lab->retire != NULL)
+        lab->active[lab->active_count++] = label;
+
+    blob_label_stats_t *s = &lab->labels[label];
+    memset(s, 0, sizeof(*s));
+    s->parent = label;
+    s->class_id = class_id;
+    s->first = first;
+    s->min_x = lab->width;
+    s->min_y = lab->height;
+    return label;
+}
+
+static void free_label(blob_labeler_t *lab, int label)
+{
+    lab->labels[label].parent = lab->free_label;
+    lab->free_label = label;
+}
+
+// Number of runs in a packed row: set bits whose left neighbour is clear
+static int count_mask_runs(const uint32_t *row_bits, int words)
+{
+    int count = 0;
+    uint32_t carry = 0;
+    for (int w = 0; w < words; w++)
+    {
+        uint32_t bits = row_bits[w];
+        count += __builtin_popcount(bits & ~((bits << 1) | carry));
+        carry = bits >> (PIXEL_MASK_WORD_BITS - 1);
+    }
+    return count;
+}
+
+// Re-lays the run ring out with room for at least needed runs per row
+static bool grow_ring(blob_labeler_t *lab, int needed)
+{
+    int capacity = lab->row_capacity * 2;
+    if (capacity < needed)
+        capacity = needed;
+
+    blob_run_t *runs = (blob_run_t *)detect_arena_alloc(lab->arena,
+                                                        (size_t)lab->ring_rows * capacity * sizeof(blob_run_t),
+                                                        INTERNAL_CAPS);
+    if (runs == NULL)
+    {
+        ESP_LOGE(TAG, "Failed to grow run ring to %d runs per row!", capacity);
+        return false;
+    }
+    for (int slot = 0; slot < lab->ring_rows; slot++)
+    {
+        memcpy(runs + (size_t)slot * capacity, lab->runs + (size_t)slot * lab->row_capacity,
+               lab->row_run_count[slot] * sizeof(blob_run_t));
+    }
+    detect_arena_free(lab->arena, lab->runs);
+    lab->runs = runs;
+    lab->row_capacity = capacity;
+    return true;
+}
+
+// Splits a packed row into runs of class_id, one word at a time
+static int extract_mask_runs(const uint32_t *row_bits, int width, int class_id, blob_run_t *runs)
+{
+    int words = (width + PIXEL_MASK_WORD_BITS - 1) / PIXEL_MASK_WORD_BITS;
+    int count = 0;
+    int start = -1;
+
+    for (int w = 0; w < words; w++)
+    {
+        uint32_t bits = row_bits[w];
+        int base = w * PIXEL_MASK_WORD_BITS;
+        int pos = 0;
+
+        while (pos < PIXEL_MASK_WORD_BITS)
+        {
+            // look for the next transition from the current state
+            uint32_t rest = (start < 0 ? bits : ~bits) >> pos;
+            if (rest == 0)
+                break;
+            pos += __builtin_ctz(rest);
+            if (start < 0)
+            {
+                start = base + pos;
+            }
+            else
+            {
+                runs[count].x0 = start;
+                runs[count].x1 = base + pos - 1;
+                runs[count].class_id = class_id;
+                count++;
+                start = -1;
+            }
+        }
+    }
+    if (start >= 0)
+    {
+        // padding bits are zero, so this only happens for width % 32 == 0
+        runs[count].x0 = start;
+        runs[count].x1 = width - 1;
+        runs[count].class_id = class_id;
+        count++;
+    }
+    return count;
+}
+
+int blob_count_class_runs(const uint8_t *class_ids, int width)
+{
+    int count = 0;
+    uint8_t prev = 0;
+    for (int x = 0; x < width; x++)
+    {
+        count += class_ids[x] != 0 && class_ids[x] != prev;
+        prev = class_ids[x];
+    }
+    return count;
+}
+
+// Splits a class-id row into runs of equal non-zero ids
+int blob_extract_class_runs(const uint8_t *class_ids, int width, blob_run_t *runs)
+{
+    int count = 0;
+    int x = 0;
+    while (x < width)
+    {
+        uint8_t id = class_ids[x];
+        if (id == 0)
+        {
+            x++;
+            continue;
+        }
+        int x0 = x;
+        while (x < width && class_ids[x] == id)
+            x++;
+        runs[count].x0 = x0;
+        runs[count].x1 = x - 1;
+        runs[count].class_id = id;
+        count++;
+    }
+    return count;
+}
+
+// Retire mode, after row y: point every run the next row can reach at its
+// root, then drop merged labels and hand finished components to the callback
+static void retire_finished(blob_labeler_t *lab, int y)
+{
+    for (int dy = 0; dy < lab->max_gap && y - dy >= lab->first_row; dy++)
+    {
+        int slot = (y - dy) % lab->ring_rows;
+        blob_run_t *runs = lab->runs + (size_t)slot * lab->row_capacity;
+        for (int r = 0; r < lab->row_run_count[slot]; r++)
+        {
+            runs[r].label = blob_label_find(lab->labels, runs[r].label);
+            lab->labels[runs[r].label].seen = y;
+        }
+    }
+
+    // nothing references a merged label any more, so every non-root goes
+    int kept = 0;
+    for (int i = 0; i < lab->active_count; i++)
+    {
+        int label = lab->active[i];
+        blob_label_stats_t *s = &lab->labels[label];
+        if (s->parent != label)
+        {
+            free_label(lab, label);
+        }
+        else if (s->seen == y)
+        {
+            lab->active[kept++] = label;
+        }
+        else
+        {
+            lab->retire(lab->retire_ctx, s);
+            free_label(lab, label);
+        }
+    }
+    lab->active_count = kept;
+}
+
+void blob_labeler_flush(blob_labeler_t *lab)
+{
+    if (lab->retire == NULL)
+        return;
+    // after retire_finished every active label is a root
+    for (int i = 0; i < lab->active_count; i++)
+    {
+        lab->retire(lab->retire_ctx, &lab->labels[lab->active[i]]);
+        free_label(lab, lab->active[i]);
+    }
+    lab->active_count = 0;
+}
+
+// Makes room for needed runs and returns the ring slot for the next row
+static blob_run_t *next_row_slot(blob_labeler_t *lab, int needed)
+{
+    if (needed > lab->row_capacity && !grow_ring(lab, needed))
+        return NULL;
+    return lab->runs + (size_t)(lab->y % lab->ring_rows) * lab->row_capacity;
+}
+
+static void accumulate_run(blob_label_stats_t *s, int x0, int x1, int y, int width)
+{
+    int len = x1 - x0 + 1;
+    s->pixel_count += len;
+    s->sum_x += (int64_t)(x0 + x1) * len / 2;
+    s->sum_y += (int64_t)y * len;
+    if (x0 < s->min_x)
+        s->min_x = x0;
+    if (x1 > s->max_x)
+        s->max_x = x1;
+    if (y < s->min_y)
+        s->min_y = y;
+    if (y > s->max_y)
+        s->max_y = y;
+    if (y * width + x0 < s->first)
+        s->first = y * width + x0;
+}
+
+// Accumulates the runs of set bits of row_bits within x0..x1
+static void accumulate_mask_span(blob_label_stats_t *s, const uint32_t *row_bits, int x0, int x1, int y,
+                                 int width)
+{
+    int x = x0;
+    while (x <= x1)
+    {
+        // next set bit, then the next clear bit after it
+        int w = x / PIXEL_MASK_WORD_BITS;
+        uint32_t bits = row_bits[w] & (~0u << (x % PIXEL_MASK_WORD_BITS));
+        while (bits == 0)
+        {
+            if (++w * PIXEL_MASK_WORD_BITS > x1)
+                return;
+            bits = row_bits[w];
+        }
+        int start = w * PIXEL_MASK_WORD_BITS + __builtin_ctz(bits);
+        if (start > x1)
+            return;
+
+        bits = ~row_bits[w] & (~0u << (start % PIXEL_MASK_WORD_BITS));
+        while (bits == 0 && ++w * PIXEL_MASK_WORD_BITS <= x1)
+            bits = ~row_bits[w];
+        int end = bits == 0 ? x1 + 1 : w * PIXEL_MASK_WORD_BITS + __builtin_ctz(bits);
+        if (end > x1 + 1)
+            end = x1 + 1;
+        accumulate_run(s, start, end - 1, y, width);
+        x = end + 1;
+    }
+}
+
+// Links the freshly extracted runs of the next row to the runs of the last
+// max_gap rows and accumulates them into their components. With pixel_bits
+// the runs only decide connectivity and the set pixels of pixel_bits inside
+// them are what is accumulated.
+static bool label_row(blob_labeler_t *lab, blob_run_t *cur, int cur_count, const uint32_t *pixel_bits)
+{
+    int y = lab->y++;
+    lab->row_run_count[y % lab->ring_rows] = cur_count;
+
+    int gap = lab->max_gap;
+    int *scan = lab->scan;
+    int *last = lab->last;
+
+    memset(scan, 0, lab->ring_rows * sizeof(int));
+    memset(last, -1, BLOB_CLASS_IDS * sizeof(int));
+
+    for (int r = 0; r < cur_count; r++)
+    {
+        blob_run_t *run = &cur[r];
+        int label = -1;
+
+        // same row: runs are sorted, so only the previous run of the class can be within reach
+        int prev_same = last[run->class_id];
+        if (prev_same >= 0 && run->x0 - cur[prev_same].x1 <= gap)
+            label = cur[prev_same].label;
+        last[run->class_id] = r;
+
+        for (int dy = 1; dy <= gap && y - dy >= lab->first_row; dy++)
+        {
+            int prev_slot = (y - dy) % lab->ring_rows;
+            const blob_run_t *prev = lab->runs + (size_t)prev_slot * lab->row_capacity;
+            int prev_count = lab->row_run_count[prev_slot];
+            int k = scan[dy - 1];
+
+            while (k < prev_count && prev[k].x1 < run->x0 - gap)
+                k++;
+            scan[dy - 1] = k;
+
+            for (; k < prev_count && prev[k].x0 <= run->x1 + gap; k++)
+            {
+                if (prev[k].class_id != run->class_id)
+                    continue;
+                label = label < 0 ? blob_label_find(lab->labels, prev[k].label)
+                                  : blob_label_union(lab->labels, label, prev[k].label);
+            }
+        }
+
+        if (label < 0)
+        {
+            label = new_label(lab, pixel_bits != NULL ? INT_MAX : y * lab->width + run->x0, run->class_id);
+            if (label < 0)
+                return false;
+        }
+        run->label = label;
+
+        // accumulate this run into its component
+        blob_label_stats_t *s = &lab->labels[blob_label_find(lab->labels, label)];
+        if (pixel_bits != NULL)
+            accumulate_mask_span(s, pixel_bits, run->x0, run->x1, y, lab->width);
+        else
+            accumulate_run(s, run->x0, run->x1, y, lab->width);
+    }
+
+    if (lab->head_runs != NULL && y - lab->first_row < lab->max_gap)
+    {
+        int row = y - lab->first_row;
+        memcpy(lab->head_runs + (size_t)row * lab->head_capacity, cur, cur_count * sizeof(blob_run_t));
+        lab->head_run_count[row] = cur_count;
+    }
+    if (lab->retire != NULL)
+        retire_finished(lab, y);
+    return true;
+}
+
+bool blob_labeler_push_row(blob_labeler_t *lab, const uint32_t *row_bits)
+{
+    int words = (lab->width + PIXEL_MASK_WORD_BITS - 1) / PIXEL_MASK_WORD_BITS;
+    blob_run_t *cur = next_row_slot(lab, count_mask_runs(row_bits, words));
+    if (cur == NULL)
+        return false;
+    return label_row(lab, cur, extract_mask_runs(row_bits, lab->width, 1, cur), NULL);
+}
+
+bool blob_labeler_push_bridged_row(blob_labeler_t *lab, const uint32_t *bridged_bits, const uint32_t *row_bits,
+                                   int class_id)
+{
+    int words = (lab->width + PIXEL_MASK_WORD_BITS - 1) / PIXEL_MASK_WORD_BITS;
+    blob_run_t *cur = next_row_slot(lab, count_mask_runs(bridged_bits, words));
+    if (cur == NULL)
+        return false;
+    return label_row(lab, cur, extract_mask_runs(bridged_bits, lab->width, class_id, cur), row_bits);
+}
+
+bool blob_labeler_push_class_row(blob_labeler_t *lab, const uint8_t *class_ids)
+{
+    blob_run_t *cur = next_row_slot(lab, blob_count_class_runs(class_ids, lab->width));
+    if (cur == NULL)
+        return false;
+    return label_row(lab, cur, blob_extract_class_runs(class_ids, lab->width, cur), NULL);
+}
+
+bool blob_labeler_push_runs(blob_labeler_t *lab, const blob_run_t *runs, int count)
+{
+    blob_run_t *cur = next_row_slot(lab, count);
+    if (cur == NULL)
+        return false;
+    if (count > 0)
+        memcpy(cur, runs, count * sizeof(blob_run_t));
+    return label_row(lab, cur, count, NULL);
+}
+
+void blob_label_to_blob(const blob_label_stats_t *stats, blob_t *blob)
+{
+    blob->pixel_count = stats->pixel_count;
+    blob->x_center = (int)(stats->sum_x / stats->pixel_count);
+    blob->y_center = (int)(stats->sum_y / stats->pixel_count);
+    blob->min_x = stats->min_x;
+    blob->max_x = stats->max_x;
+    blob->min_y = stats->min_y;
+    blob->max_y = stats->max_y;
+}
+
+const blob_label_stats_t *blob_labeler_next(blob_labeler_t *lab, int *cursor)
+{
+    for (; *cursor < lab->label_count; (*cursor)++)
+    {
+        if (lab->labels[*cursor].parent == *cursor)
+            return &lab->labels[(*cursor)++];
+    }
+    return NULL;
+}
+
+int find_blobs_flood(const pixel_mask_t *pixel_mask, int max_gap, int min_pixels,
+                     blob_t *blobs, int max_blobs)
+{
+    int width = pixel_mask->width;
+    int height = pixel_mask->height;
+    int blob_count = 0;
+
+    pixel_mask_t visited;
+    if (!pixel_mask_init(&visited, width, height, MALLOC_CAP_SPIRAM))
+        return 0;
+
+    int *stack = (int *)heap_caps_malloc((size_t)width * height * sizeof(int), MALLOC_CAP_SPIRAM);
+    if (stack == NULL)
+    {
+        ESP_LOGE(TAG, "Failed to allocate stack in PSRAM!");
+        pixel_mask_free(&visited);
+        return 0;
+    }
+
+    for (int sy = 0; sy < height; sy++)
+    {
+        for (int sx = pixel_mask_row_next(pixel_mask, sy, 0); sx >= 0;
+             sx = pixel_mask_row_next(pixel_mask, sy, sx + 1))
+        {
+            if (pixel_mask_test(&visited, sx, sy))
+                continue;
+
+            blob_t blob = {0};
+            blob.min_x = width;
+            blob.min_y = height;
+
+            int stack_ptr = 0;
+            stack[stack_ptr++] = sy * width + sx;
+            pixel_mask_set(&visited, sx, sy);
+
+            while (stack_ptr > 0)
+            {
+                int idx = stack[--stack_ptr];
+                int x = idx % width;
+                int y = idx / width;
+
+                if (x < blob.min_x)
+                    blob.min_x = x;
+                if (x > blob.max_x)
+                    blob.max_x = x;
+                if (y < blob.min_y)
+                    blob.min_y = y;
+                if (y > blob.max_y)
+                    blob.max_y = y;
+
+                blob.pixel_count++;
+                blob.x_center += x;
+                blob.y_center += y;
+
+                for (int dy = -max_gap; dy <= max_gap; dy++)
+                {
+                    for (int dx = -max_gap; dx <= max_gap; dx++)
+                    {
+                        int nx = x + dx;
+                        int ny = y + dy;
+
+                        if (nx >= 0 && nx < width && ny >= 0 && ny < height &&
+                            !pixel_mask_test(&visited, nx, ny) && pixel_mask_test(pixel_mask, nx, ny))
+                        {
+                            pixel_mask_set(&visited, nx, ny);
+                            stack[stack_ptr++] = ny * width + nx;
+                        }
+                    }
+                }
+            }
+
+            blob.x_center /= blob.pixel_count;
+            blob.y_center /= blob.pixel_count;
+            if (blob.pixel_count >= min_pixels && blob_count < max_blobs)
+                blobs[blob_count++] = blob;
+        }
+    }
+
+    pixel_mask_free(&visited);
+    heap_caps_free(stack);
+    return blob_count;
+}
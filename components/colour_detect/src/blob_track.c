@@ -0,0 +1,127 @@
+#include <string.h>
+#include "blob_track.h"
+
+#define NO_MATCH INT64_MIN
+
+void blob_tracker_init(blob_tracker_t *tracker, int max_distance, int max_missed)
+{
+    memset(tracker, 0, sizeof(*tracker));
+    tracker->max_distance = max_distance;
+    tracker->max_missed = max_missed;
+    tracker->next_id = 1;
+}
+
+// Overlap area when the boxes overlap (always > 0), else minus the squared
+// centre distance; higher is the better match
+static int64_t match_score(const blob_tracker_t *tracker, const blob_t *a, const blob_t *b)
+{
+    int w = (a->max_x < b->max_x ? a->max_x : b->max_x) - (a->min_x > b->min_x ? a->min_x : b->min_x) + 1;
+    int h = (a->max_y < b->max_y ? a->max_y : b->max_y) - (a->min_y > b->min_y ? a->min_y : b->min_y) + 1;
+    if (w > 0 && h > 0)
+        return (int64_t)w * h;
+
+    int64_t dx = a->x_center - b->x_center;
+    int64_t dy = a->y_center - b->y_center;
+    int64_t d2 = dx * dx + dy * dy;
+    if (d2 > (int64_t)tracker->max_distance * tracker->max_distance)
+        return NO_MATCH;
+    return -d2;
+}
+
+// Slot for a new track; when full, the track missing longest makes room
+static blob_track_t *new_track(blob_tracker_t *tracker)
+{
+    if (tracker->track_count < BLOB_TRACK_MAX)
+        return &tracker->tracks[tracker->track_count++];
+
+    blob_track_t *oldest = NULL;
+    for (int t = 0; t < tracker->track_count; t++)
+    {
+        if (tracker->tracks[t].missed > 0 && (oldest == NULL || tracker->tracks[t].missed > oldest->missed))
+            oldest = &tracker->tracks[t];
+    }
+    return oldest;
+}
+
+void blob_tracker_update(blob_tracker_t *tracker, const frame_result_t *result)
+{
+    bool track_matched[BLOB_TRACK_MAX] = {false};
+    int track_count = tracker->track_count;
+
+    memset(tracker->ids, 0, sizeof(tracker->ids));
+
+    // Greedy: repeatedly take the best remaining track / blob pair
+    while (true)
+    {
+        int64_t best = NO_MATCH;
+        int best_track = -1;
+        int best_class = -1;
+        int best_blob = -1;
+        for (int t = 0; t < track_count; t++)
+        {
+            const blob_track_t *track = &tracker->tracks[t];
+            if (track_matched[t])
+                continue;
+            int c = track->class_id - 1;
+            if (c >= result->class_count)
+                continue;
+            const class_result_t *cls = &result->classes[c];
+            for (int i = 0; i < cls->blob_count; i++)
+            {
+                if (tracker->ids[c][i] != 0)
+                    continue;
+                int64_t score = match_score(tracker, &track->blob, &cls->blobs[i].blob);
+                if (score > best)
+                {
+                    best = score;
+                    best_track = t;
+                    best_class = c;
+                    best_blob = i;
+                }
+            }
+        }
+        if (best_track < 0)
+            break;
+
+        blob_track_t *track = &tracker->tracks[best_track];
+        track->blob = result->classes[best_class].blobs[best_blob].blob;
+        track->age++;
+        track->missed = 0;
+        track_matched[best_track] = true;
+        tracker->ids[best_class][best_blob] = track->id;
+    }
+
+    // Age out unmatched tracks, keeping the order of the rest
+    int kept = 0;
+    for (int t = 0; t < track_count; t++)
+    {
+        blob_track_t *track = &tracker->tracks[t];
+        if (!track_matched[t] && ++track->missed > tracker->max_missed)
+            continue;
+        tracker->tracks[kept++] = *track;
+    }
+    tracker->track_count = kept;
+
+    // Blobs left over start tracks, in class and raster order
+    for (int c = 0; c < result->class_count; c++)
+    {
+        const class_result_t *cls = &result->classes[c];
+        for (int i = 0; i < cls->blob_count; i++)
+        {
+            if (tracker->ids[c][i] != 0)
+                continue;
+            blob_track_t *track = new_track(tracker);
+            if (track == NULL)
+            {
+                tracker->ids[c][i] = -1;
+                continue;
+            }
+            track->id = tracker->next_id++;
+            track->class_id = c + 1;
+            track->blob = cls->blobs[i].blob;
+            track->age = 1;
+            track->missed = 0;
+            tracker->ids[c][i] = track->id;
+        }
+    }
+}
@@ -0,0 +1,410 @@
+#include <string.h>
+#include "detect_port.h"
+#include "class_kernel.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#include <immintrin.h>
+#define CLASS_KERNEL_HAVE_AVX2 1
+#endif
+
+static const char *TAG = "class_kernel";
+
+static const char *const variant_names[CLASS_KERNEL_COUNT] = {"swar", "vector", "sse2", "avx2"};
+
+// Every kernel step does the same per pixel:
+//   r, g, b  scaled to 8 bits as rgb565_to_hsv does, r5 * 255 / 31 being
+//            (r5 * 1053) >> 7 and g6 * 255 / 63 being 4 * g6 + (g6 * 49 >> 10)
+//   h        0 if delta is 0, else by which channels equal max / min:
+//            r max: 15 if g is max too, 75 if b is, else 90 if g < b, else 0
+//            g max: 45 if b is max too, else 30
+//            b max: 60
+//   s        compared as products against max, with max 0 read as 1
+// and then ANDs the six compares per class, clears the pixels an earlier
+// class took and packs one bit per pixel.
+#define SCALE5_MUL 1053
+#define SCALE5_SHIFT 7
+#define SCALE6_MUL 49
+#define SCALE6_SHIFT 10
+
+void class_kernel_init(class_kernel_t *kernel, class_kernel_variant_t variant, const color_threshold_t *thresholds,
+                       int count, bool swapped)
+{
+    memset(kernel, 0, sizeof(*kernel));
+    kernel->class_count = count < CLASS_KERNEL_MAX_CLASSES ? count : CLASS_KERNEL_MAX_CLASSES;
+    kernel->swapped = swapped;
+    for (int c = 0; c < kernel->class_count; c++)
+    {
+        class_kernel_bounds_t *b = &kernel->bounds[c];
+        b->h_min = thresholds[c].h_min;
+        b->h_max = thresholds[c].h_max;
+        b->v_min = thresholds[c].v_min;
+        b->v_max = thresholds[c].v_max;
+        b->s_min = thresholds[c].s_min;
+        b->s_limit = (uint16_t)(thresholds[c].s_max + 1);
+    }
+
+    kernel->variant = variant;
+    if (!class_kernel_available(kernel->variant))
+    {
+        ESP_LOGW(TAG, "%s kernel unavailable, using swar", class_kernel_name(kernel->variant));
+        kernel->variant = CLASS_KERNEL_SWAR;
+    }
+}
+
+bool class_kernel_available(class_kernel_variant_t variant)
+{
+    switch (variant)
+    {
+    case CLASS_KERNEL_SWAR:
+        return true;
+#if defined(__GNUC__)
+    case CLASS_KERNEL_VECTOR:
+        return true;
+#endif
+#if defined(__SSE2__)
+    case CLASS_KERNEL_SSE2:
+        return true;
+#endif
+#if CLASS_KERNEL_HAVE_AVX2
+    case CLASS_KERNEL_AVX2:
+        return __builtin_cpu_supports("avx2");
+#endif
+    default:
+        return false;
+    }
+}
+
+const char *class_kernel_name(class_kernel_variant_t variant)
+{
+    return variant < CLASS_KERNEL_COUNT ? variant_names[variant] : "?";
+}
+
+bool class_kernel_parse(const char *name, class_kernel_variant_t *variant)
+{
+    for (int v = 0; v < CLASS_KERNEL_COUNT; v++)
+    {
+        if (strcmp(name, variant_names[v]) == 0)
+        {
+            *variant = (class_kernel_variant_t)v;
+            return true;
+        }
+    }
+    return false;
+}
+
+// SWAR: two 16-bit lanes per uint32_t. Every intermediate stays below 2^16,
+// so products by a constant never carry into the neighbour lane.
+#define SWAR_ONES 0x00010001u
+#define SWAR_HIGH 0x80008000u
+
+static inline uint32_t swar_expand(uint32_t high)
+{
+    // lane bit 15 to a whole lane
+    return (high >> 15) * 0xFFFFu;
+}
+
+// a < b for lanes below 2^15: the guard bit survives a - b unless it borrows
+static inline uint32_t swar_lt15(uint32_t a, uint32_t b)
+{
+    return swar_expand(~((a | SWAR_HIGH) - b) & SWAR_HIGH);
+}
+
+// a < b for full 16-bit lanes
+static inline uint32_t swar_lt(uint32_t a, uint32_t b)
+{
+    // borrow out of each lane of a - b (Hacker's Delight 2-18)
+    uint32_t diff = ((a | SWAR_HIGH) - (b & ~SWAR_HIGH)) ^ ((a ^ ~b) & SWAR_HIGH);
+    return swar_expand(((~a & b) | (~(a ^ b) & diff)) & SWAR_HIGH);
+}
+
+static inline uint32_t swar_eq(uint32_t a, uint32_t b)
+{
+    uint32_t x = a ^ b;
+    uint32_t nonzero = (((x & ~SWAR_HIGH) + ~SWAR_HIGH) | x) & SWAR_HIGH;
+    return swar_expand(~nonzero & SWAR_HIGH);
+}
+
+static inline uint32_t swar_sel(uint32_t mask, uint32_t a, uint32_t b)
+{
+    return (a & mask) | (b & ~mask);
+}
+
+static void classify_swar(const class_kernel_t *kernel, const uint16_t *pixels, uint32_t *bits)
+{
+    for (int i = 0; i < 32; i += 2)
+    {
+        uint32_t p = pixels[i] | (uint32_t)pixels[i + 1] << 16;
+        if (kernel->swapped)
+            p = ((p >> 8) & 0x00FF00FFu) | ((p << 8) & 0xFF00FF00u);
+
+        uint32_t r = ((((p >> 11) & 0x001F001Fu) * SCALE5_MUL) >> SCALE5_SHIFT) & 0x00FF00FFu;
+        uint32_t g6 = (p >> 5) & 0x003F003Fu;
+        uint32_t g = (g6 << 2) + (((g6 * SCALE6_MUL) >> SCALE6_SHIFT) & 0x00030003u);
+        uint32_t b = (((p & 0x001F001Fu) * SCALE5_MUL) >> SCALE5_SHIFT) & 0x00FF00FFu;
+
+        uint32_t max = swar_sel(swar_lt15(r, g), g, r);
+        max = swar_sel(swar_lt15(max, b), b, max);
+        uint32_t min = swar_sel(swar_lt15(g, r), g, r);
+        min = swar_sel(swar_lt15(b, min), b, min);
+        uint32_t delta255 = (max - min) * 255;
+        uint32_t max1 = max | (swar_eq(max, 0) & SWAR_ONES);
+
+        uint32_t g_max = swar_eq(g, max);
+        uint32_t b_max = swar_eq(b, max);
+        uint32_t h_r = swar_sel(g_max, 15 * SWAR_ONES,
+                                swar_sel(b_max, 75 * SWAR_ONES, swar_lt15(g, b) & (90 * SWAR_ONES)));
+        uint32_t h_g = swar_sel(b_max, 45 * SWAR_ONES, 30 * SWAR_ONES);
+        uint32_t h = swar_sel(swar_eq(r, max), h_r, swar_sel(g_max, h_g, 60 * SWAR_ONES));
+        h &= ~swar_eq(max, min);
+
+        uint32_t taken = 0;
+        for (int c = 0; c < kernel->class_count; c++)
+        {
+            const class_kernel_bounds_t *bd = &kernel->bounds[c];
+            uint32_t out = swar_lt15(h, bd->h_min * SWAR_ONES) | swar_lt15(bd->h_max * SWAR_ONES, h) |
+                           swar_lt15(max, bd->v_min * SWAR_ONES) | swar_lt15(bd->v_max * SWAR_ONES, max) |
+                           swar_lt(delta255, max1 * bd->s_min) | ~swar_lt(delta255, max1 * bd->s_limit);
+            uint32_t match = ~out & ~taken;
+            taken |= match;
+            bits[c] |= ((match & 1) | ((match >> 15) & 2)) << i;
+        }
+    }
+}
+
+#if defined(__GNUC__)
+// Vector extensions: the compiler maps these to whatever SIMD the target
+// has, or to scalar code. Compares give 0 / -1 lanes.
+typedef uint16_t v8u16 __attribute__((vector_size(16)));
+
+static inline v8u16 vector_sel(v8u16 mask, v8u16 a, v8u16 b)
+{
+    return (a & mask) | (b & ~mask);
+}
+
+static void classify_vector(const class_kernel_t *kernel, const uint16_t *pixels, uint32_t *bits)
+{
+    const v8u16 weights = {1, 2, 4, 8, 16, 32, 64, 128};
+    for (int i = 0; i < 32; i += 8)
+    {
+        v8u16 p;
+        memcpy(&p, pixels + i, sizeof(p));
+        if (kernel->swapped)
+            p = (v8u16)((p >> 8) | (p << 8));
+
+        v8u16 r = ((p >> 11) * SCALE5_MUL) >> SCALE5_SHIFT;
+        v8u16 g6 = (p >> 5) & 0x3F;
+        v8u16 g = (g6 << 2) + ((g6 * SCALE6_MUL) >> SCALE6_SHIFT);
+        v8u16 b = ((p & 0x1F) * SCALE5_MUL) >> SCALE5_SHIFT;
+
+        v8u16 max = vector_sel((v8u16)(r < g), g, r);
+        max = vector_sel((v8u16)(max < b), b, max);
+        v8u16 min = vector_sel((v8u16)(g < r), g, r);
+        min = vector_sel((v8u16)(b < min), b, min);
+        v8u16 delta255 = (max - min) * 255;
+        v8u16 max1 = max | ((v8u16)(max == 0) & 1);
+
+        v8u16 g_max = (v8u16)(g == max);
+        v8u16 b_max = (v8u16)(b == max);
+        v8u16 zero = {0};
+        v8u16 h_r = vector_sel(g_max, zero + 15, vector_sel(b_max, zero + 75, (v8u16)(g < b) & 90));
+        v8u16 h_g = vector_sel(b_max, zero + 45, zero + 30);
+        v8u16 h = vector_sel((v8u16)(r == max), h_r, vector_sel(g_max, h_g, zero + 60));
+        h &= ~(v8u16)(max == min);
+
+        v8u16 taken = zero;
+        for (int c = 0; c < kernel->class_count; c++)
+        {
+            const class_kernel_bounds_t *bd = &kernel->bounds[c];
+            v8u16 in = (v8u16)(h >= bd->h_min) & (v8u16)(h <= bd->h_max) & (v8u16)(max >= bd->v_min) &
+                       (v8u16)(max <= bd->v_max) & (v8u16)(delta255 >= max1 * bd->s_min) &
+                       (v8u16)(delta255 < max1 * bd->s_limit);
+            v8u16 match = in & ~taken;
+            taken |= match;
+
+            v8u16 lanes = match & weights;
+            uint32_t packed = 0;
+            for (int l = 0; l < 8; l++)
+                packed |= lanes[l];
+            bits[c] |= packed << i;
+        }
+    }
+}
+#endif
+
+#if defined(__SSE2__)
+// Channels, h and v stay below 256, so the signed 16-bit compares of SSE2
+// apply; the saturation products need unsigned ones, a >= b being
+// subs_epu16(b, a) == 0.
+static inline __m128i sse2_sel(__m128i mask, __m128i a, __m128i b)
+{
+    return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+}
+
+static inline __m128i sse2_ge_u16(__m128i a, __m128i b)
+{
+    return _mm_cmpeq_epi16(_mm_subs_epu16(b, a), _mm_setzero_si128());
+}
+
+static void classify_sse2(const class_kernel_t *kernel, const uint16_t *pixels, uint32_t *bits)
+{
+    const __m128i zero = _mm_setzero_si128();
+    for (int i = 0; i < 32; i += 8)
+    {
+        __m128i p = _mm_loadu_si128((const __m128i *)(pixels + i));
+        if (kernel->swapped)
+            p = _mm_or_si128(_mm_srli_epi16(p, 8), _mm_slli_epi16(p, 8));
+
+        __m128i r = _mm_srli_epi16(_mm_mullo_epi16(_mm_srli_epi16(p, 11), _mm_set1_epi16(SCALE5_MUL)),
+                                   SCALE5_SHIFT);
+        __m128i g6 = _mm_and_si128(_mm_srli_epi16(p, 5), _mm_set1_epi16(0x3F));
+        __m128i g = _mm_add_epi16(_mm_slli_epi16(g6, 2),
+                                  _mm_srli_epi16(_mm_mullo_epi16(g6, _mm_set1_epi16(SCALE6_MUL)), SCALE6_SHIFT));
+        __m128i b = _mm_srli_epi16(_mm_mullo_epi16(_mm_and_si128(p, _mm_set1_epi16(0x1F)),
+                                                   _mm_set1_epi16(SCALE5_MUL)),
+                                   SCALE5_SHIFT);
+
+        __m128i max = _mm_max_epi16(_mm_max_epi16(r, g), b);
+        __m128i min = _mm_min_epi16(_mm_min_epi16(r, g), b);
+        __m128i delta255 = _mm_mullo_epi16(_mm_sub_epi16(max, min), _mm_set1_epi16(255));
+        __m128i max1 = _mm_max_epi16(max, _mm_set1_epi16(1));
+
+        __m128i g_max = _mm_cmpeq_epi16(g, max);
+        __m128i b_max = _mm_cmpeq_epi16(b, max);
+        __m128i h_r = sse2_sel(g_max, _mm_set1_epi16(15),
+                               sse2_sel(b_max, _mm_set1_epi16(75),
+                                        _mm_and_si128(_mm_cmplt_epi16(g, b), _mm_set1_epi16(90))));
+        __m128i h_g = sse2_sel(b_max, _mm_set1_epi16(45), _mm_set1_epi16(30));
+        __m128i h = sse2_sel(_mm_cmpeq_epi16(r, max), h_r, sse2_sel(g_max, h_g, _mm_set1_epi16(60)));
+        h = _mm_andnot_si128(_mm_cmpeq_epi16(max, min), h);
+
+        __m128i taken = zero;
+        for (int c = 0; c < kernel->class_count; c++)
+        {
+            const class_kernel_bounds_t *bd = &kernel->bounds[c];
+            __m128i out = _mm_or_si128(_mm_cmplt_epi16(h, _mm_set1_epi16(bd->h_min)),
+                                       _mm_cmpgt_epi16(h, _mm_set1_epi16(bd->h_max)));
+            out = _mm_or_si128(out, _mm_cmplt_epi16(max, _mm_set1_epi16(bd->v_min)));
+            out = _mm_or_si128(out, _mm_cmpgt_epi16(max, _mm_set1_epi16(bd->v_max)));
+            __m128i s_in = _mm_andnot_si128(
+                sse2_ge_u16(delta255, _mm_mullo_epi16(max1, _mm_set1_epi16((short)bd->s_limit))),
+                sse2_ge_u16(delta255, _mm_mullo_epi16(max1, _mm_set1_epi16((short)bd->s_min))));
+            __m128i match = _mm_andnot_si128(_mm_or_si128(out, taken), s_in);
+            taken = _mm_or_si128(taken, match);
+            bits[c] |= (uint32_t)(_mm_movemask_epi8(_mm_packs_epi16(match, zero)) & 0xFF) << i;
+        }
+    }
+}
+#endif
+
+#if CLASS_KERNEL_HAVE_AVX2
+// Same steps as SSE2 on 16 lanes, compiled for AVX2 whatever the build
+// flags, and only run where the CPU has it
+#define AVX2_TARGET __attribute__((target("avx2")))
+
+static inline AVX2_TARGET __m256i avx2_sel(__m256i mask, __m256i a, __m256i b)
+{
+    return _mm256_blendv_epi8(b, a, mask);
+}
+
+static inline AVX2_TARGET __m256i avx2_ge_u16(__m256i a, __m256i b)
+{
+    return _mm256_cmpeq_epi16(_mm256_max_epu16(a, b), a);
+}
+
+static AVX2_TARGET void classify_avx2(const class_kernel_t *kernel, const uint16_t *pixels, uint32_t *bits)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    for (int i = 0; i < 32; i += 16)
+    {
+        __m256i p = _mm256_loadu_si256((const __m256i *)(pixels + i));
+        if (kernel->swapped)
+            p = _mm256_or_si256(_mm256_srli_epi16(p, 8), _mm256_slli_epi16(p, 8));
+
+        __m256i r = _mm256_srli_epi16(
+            _mm256_mullo_epi16(_mm256_srli_epi16(p, 11), _mm256_set1_epi16(SCALE5_MUL)), SCALE5_SHIFT);
+        __m256i g6 = _mm256_and_si256(_mm256_srli_epi16(p, 5), _mm256_set1_epi16(0x3F));
+        __m256i g = _mm256_add_epi16(
+            _mm256_slli_epi16(g6, 2),
+            _mm256_srli_epi16(_mm256_mullo_epi16(g6, _mm256_set1_epi16(SCALE6_MUL)), SCALE6_SHIFT));
+        __m256i b = _mm256_srli_epi16(_mm256_mullo_epi16(_mm256_and_si256(p, _mm256_set1_epi16(0x1F)),
+                                                         _mm256_set1_epi16(SCALE5_MUL)),
+                                      SCALE5_SHIFT);
+
+        __m256i max = _mm256_max_epi16(_mm256_max_epi16(r, g), b);
+        __m256i min = _mm256_min_epi16(_mm256_min_epi16(r, g), b);
+        __m256i delta255 = _mm256_mullo_epi16(_mm256_sub_epi16(max, min), _mm256_set1_epi16(255));
+        __m256i max1 = _mm256_max_epi16(max, _mm256_set1_epi16(1));
+
+        __m256i g_max = _mm256_cmpeq_epi16(g, max);
+        __m256i b_max = _mm256_cmpeq_epi16(b, max);
+        __m256i h_r = avx2_sel(g_max, _mm256_set1_epi16(15),
+                               avx2_sel(b_max, _mm256_set1_epi16(75),
+                                        _mm256_and_si256(_mm256_cmpgt_epi16(b, g), _mm256_set1_epi16(90))));
+        __m256i h_g = avx2_sel(b_max, _mm256_set1_epi16(45), _mm256_set1_epi16(30));
+        __m256i h = avx2_sel(_mm256_cmpeq_epi16(r, max), h_r, avx2_sel(g_max, h_g, _mm256_set1_epi16(60)));
+        h = _mm256_andnot_si256(_mm256_cmpeq_epi16(max, min), h);
+
+        __m256i taken = zero;
+        for (int c = 0; c < kernel->class_count; c++)
+        {
+            const class_kernel_bounds_t *bd = &kernel->bounds[c];
+            __m256i out = _mm256_or_si256(_mm256_cmpgt_epi16(_mm256_set1_epi16(bd->h_min), h),
+                                          _mm256_cmpgt_epi16(h, _mm256_set1_epi16(bd->h_max)));
+            out = _mm256_or_si256(out, _mm256_cmpgt_epi16(_mm256_set1_epi16(bd->v_min), max));
+            out = _mm256_or_si256(out, _mm256_cmpgt_epi16(max, _mm256_set1_epi16(bd->v_max)));
+            __m256i s_in = _mm256_andnot_si256(
+                avx2_ge_u16(delta255, _mm256_mullo_epi16(max1, _mm256_set1_epi16((short)bd->s_limit))),
+                avx2_ge_u16(delta255, _mm256_mullo_epi16(max1, _mm256_set1_epi16((short)bd->s_min))));
+            __m256i match = _mm256_andnot_si256(_mm256_or_si256(out, taken), s_in);
+            taken = _mm256_or_si256(taken, match);
+            // packs works per 128-bit half: pixels 0-7 land in bytes 0-7, 8-15 in bytes 16-23
+            uint32_t mask = (uint32_t)_mm256_movemask_epi8(_mm256_packs_epi16(match, zero));
+            bits[c] |= ((mask & 0xFF) | ((mask >> 8) & 0xFF00)) << i;
+        }
+    }
+}
+#endif
+
+void class_kernel_classify(const class_kernel_t *kernel, const uint16_t *pixels, int count, uint32_t *bits)
+{
+    // the variants always work on 32 pixels; a short span is padded
+    uint16_t padded[32];
+    if (count < 32)
+    {
+        memcpy(padded, pixels, count * sizeof(uint16_t));
+        memset(padded + count, 0, (32 - count) * sizeof(uint16_t));
+        pixels = padded;
+    }
+    memset(bits, 0, kernel->class_count * sizeof(uint32_t));
+
+    switch (kernel->variant)
+    {
+#if defined(__GNUC__)
+    case CLASS_KERNEL_VECTOR:
+        classify_vector(kernel, pixels, bits);
+        break;
+#endif
+#if defined(__SSE2__)
+    case CLASS_KERNEL_SSE2:
+        classify_sse2(kernel, pixels, bits);
+        break;
+#endif
+#if CLASS_KERNEL_HAVE_AVX2
+    case CLASS_KERNEL_AVX2:
+        classify_avx2(kernel, pixels, bits);
+        break;
+#endif
+    default:
+        classify_swar(kernel, pixels, bits);
+        break;
+    }
+
+    if (count < 32)
+    {
+        for (int c = 0; c < kernel->class_count; c++)
+            bits[c] &= (1u << count) - 1;
+    }
+}
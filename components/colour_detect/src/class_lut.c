@@ -0,0 +1,287 @@
+#include <string.h>
+#include "detect_port.h"
+#include "class_lut.h"
+
+static const char *TAG = "class_lut";
+
+// Same first-match-wins order as the original per-pixel classification
+static uint8_t classify_scalar(uint16_t rgb565, const color_threshold_t *thresholds, int count)
+{
+    hsv_t hsv = rgb565_to_hsv(rgb565);
+    for (int c = 0; c < count; c++)
+    {
+        if (matches_threshold(hsv, thresholds[c]))
+            return (uint8_t)(c + 1);
+    }
+    return CLASS_NONE;
+}
+
+bool class_lut_init(class_lut_t *lut, class_lut_mem_t mem)
+{
+    return class_lut_init_format(lut, mem, PIXEL_FORMAT_RGB565);
+}
+
+bool class_lut_init_format(class_lut_t *lut, class_lut_mem_t mem, pixel_format_t format)
+{
+    memset(lut, 0, sizeof(*lut));
+    lut->format = format;
+    lut->kernel.variant = CLASS_KERNEL_DEFAULT;
+    lut->mem = mem;
+    if (mem == CLASS_LUT_MEM_NONE)
+        return true;
+
+    if (mem == CLASS_LUT_MEM_INTERNAL)
+    {
+        lut->table = (uint8_t *)heap_caps_malloc(CLASS_LUT_SIZE, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+        if (lut->table == NULL)
+        {
+            ESP_LOGW(TAG, "No internal SRAM for class table, falling back to PSRAM");
+            mem = CLASS_LUT_MEM_PSRAM;
+        }
+    }
+    if (lut->table == NULL)
+    {
+        lut->table = (uint8_t *)heap_caps_malloc(CLASS_LUT_SIZE, MALLOC_CAP_SPIRAM);
+    }
+    if (lut->table == NULL)
+    {
+        ESP_LOGE(TAG, "Failed to allocate class table!");
+        return false;
+    }
+
+    lut->mem = mem;
+    return true;
+}
+
+bool class_lut_set_kernel(class_lut_t *lut, class_kernel_variant_t variant)
+{
+    if (!class_kernel_available(variant))
+        return false;
+    lut->kernel.variant = variant;
+    return true;
+}
+
+void class_lut_free(class_lut_t *lut)
+{
+    heap_caps_free(lut->table);
+    lut->table = NULL;
+    lut->built = false;
+}
+
+bool class_lut_update(class_lut_t *lut, const color_threshold_t *thresholds, int count)
+{
+    if (count > CLASS_LUT_MAX_CLASSES)
+    {
+        ESP_LOGW(TAG, "%d classes requested, only %d supported", count, CLASS_LUT_MAX_CLASSES);
+        count = CLASS_LUT_MAX_CLASSES;
+    }
+
+    if (lut->built && lut->class_count == count &&
+        memcmp(lut->thresholds, thresholds, count * sizeof(color_threshold_t)) == 0)
+    {
+        return false;
+    }
+
+    if (lut->table == NULL)
+    {
+        class_kernel_init(&lut->kernel, lut->kernel.variant, thresholds, count,
+                          lut->format == PIXEL_FORMAT_RGB565_BE);
+    }
+    else
+    {
+        for (int i = 0; i < CLASS_LUT_SIZE; i++)
+        {
+            lut->table[i] =
+                classify_scalar(pixel_format_index_colour(lut->format, (uint16_t)i), thresholds, count);
+        }
+    }
+
+    memcpy(lut->thresholds, thresholds, count * sizeof(color_threshold_t));
+    lut->class_count = count;
+    lut->built = true;
+    return true;
+}
+
+// Kernel input for count <= 32 format indices: RGB565 pixels are their own
+// index, other formats go through the colour an index stands for
+static const uint16_t *kernel_pixels(const class_lut_t *lut, const uint16_t *indices, int count, uint16_t *buf)
+{
+    if (lut->format == PIXEL_FORMAT_RGB565 || lut->format == PIXEL_FORMAT_RGB565_BE)
+        return indices;
+    for (int i = 0; i < count; i++)
+    {
+        buf[i] = pixel_format_index_colour(lut->format, indices[i]);
+    }
+    return buf;
+}
+
+// class_lut_classify_ids of the table, for count <= 32 format indices
+static void kernel_ids(const class_lut_t *lut, const uint16_t *indices, int count, uint8_t *class_ids)
+{
+    uint16_t buf[PIXEL_MASK_WORD_BITS];
+    uint32_t bits[CLASS_LUT_MAX_CLASSES];
+
+    class_kernel_classify(&lut->kernel, kernel_pixels(lut, indices, count, buf), count, bits);
+    memset(class_ids, CLASS_NONE, count);
+    for (int c = 0; c < lut->class_count; c++)
+    {
+        for (uint32_t m = bits[c]; m != 0; m &= m - 1)
+        {
+            class_ids[__builtin_ctz(m)] = (uint8_t)(c + 1);
+        }
+    }
+}
+
+uint8_t class_lut_classify_index(const class_lut_t *lut, uint16_t index)
+{
+    uint8_t id;
+    kernel_ids(lut, &index, 1, &id);
+    return id;
+}
+
+int class_lut_verify(const class_lut_t *lut)
+{
+    int mismatches = 0;
+    for (int i = 0; i < CLASS_LUT_SIZE; i += PIXEL_MASK_WORD_BITS)
+    {
+        uint16_t indices[PIXEL_MASK_WORD_BITS];
+        uint8_t ids[PIXEL_MASK_WORD_BITS];
+        for (int k = 0; k < PIXEL_MASK_WORD_BITS; k++)
+        {
+            indices[k] = (uint16_t)(i + k);
+            ids[k] = lut->table != NULL ? lut->table[i + k] : 0;
+        }
+        if (lut->table == NULL)
+            kernel_ids(lut, indices, PIXEL_MASK_WORD_BITS, ids);
+
+        for (int k = 0; k < PIXEL_MASK_WORD_BITS; k++)
+        {
+            uint16_t rgb565 = pixel_format_index_colour(lut->format, indices[k]);
+            if (ids[k] != classify_scalar(rgb565, lut->thresholds, lut->class_count))
+                mismatches++;
+        }
+    }
+    return mismatches;
+}
+
+// Format indices of count <= 32 pixels from x0; RGB565 rows are used in place
+static const uint16_t *row_indices(const class_lut_t *lut, const uint8_t *row, int x0, int count, uint16_t *buf)
+{
+    if (lut->format == PIXEL_FORMAT_RGB565 || lut->format == PIXEL_FORMAT_RGB565_BE)
+        return (const uint16_t *)row + x0;
+    for (int i = 0; i < count; i++)
+    {
+        buf[i] = pixel_format_index(lut->format, row, x0 + i);
+    }
+    return buf;
+}
+
+void class_lut_classify_row(const class_lut_t *lut, const uint8_t *row, int y, pixel_mask_t *masks)
+{
+    int width = masks[0].width;
+    uint8_t ids[PIXEL_MASK_WORD_BITS];
+
+    if (lut->table == NULL)
+    {
+        // the kernel packs the mask words itself
+        for (int w = 0; w < masks[0].words_per_row; w++)
+        {
+            int x0 = w * PIXEL_MASK_WORD_BITS;
+            int n = width - x0 < PIXEL_MASK_WORD_BITS ? width - x0 : PIXEL_MASK_WORD_BITS;
+            uint16_t indices[PIXEL_MASK_WORD_BITS];
+            uint16_t buf[PIXEL_MASK_WORD_BITS];
+            uint32_t bits[CLASS_LUT_MAX_CLASSES];
+            const uint16_t *px = kernel_pixels(lut, row_indices(lut, row, x0, n, indices), n, buf);
+
+            class_kernel_classify(&lut->kernel, px, n, bits);
+            for (int c = 0; c < lut->class_count; c++)
+            {
+                pixel_mask_store_word(&masks[c], y, w, bits[c]);
+            }
+        }
+        return;
+    }
+
+    for (int w = 0; w < masks[0].words_per_row; w++)
+    {
+        int x0 = w * PIXEL_MASK_WORD_BITS;
+        int n = width - x0 < PIXEL_MASK_WORD_BITS ? width - x0 : PIXEL_MASK_WORD_BITS;
+        // slot 0 collects unclassified pixels and is never stored
+        uint32_t bits[CLASS_LUT_MAX_CLASSES + 1] = {0};
+
+        class_lut_classify_ids(lut, row, x0, n, ids);
+        for (int b = 0; b < n; b++)
+        {
+            bits[ids[b]] |= 1u << b;
+        }
+        for (int c = 0; c < lut->class_count; c++)
+        {
+            pixel_mask_store_word(&masks[c], y, w, bits[c + 1]);
+        }
+    }
+}
+
+// One loop per format, so the format is decided once per row and each loop
+// is a plain load, index and table lookup per pixel
+void class_lut_classify_ids(const class_lut_t *lut, const uint8_t *row, int x0, int width, uint8_t *class_ids)
+{
+    const uint8_t *table = lut->table;
+    if (table == NULL)
+    {
+        for (int x = 0; x < width; x += PIXEL_MASK_WORD_BITS)
+        {
+            int n = width - x < PIXEL_MASK_WORD_BITS ? width - x : PIXEL_MASK_WORD_BITS;
+            uint16_t indices[PIXEL_MASK_WORD_BITS];
+            kernel_ids(lut, row_indices(lut, row, x0 + x, n, indices), n, class_ids + x);
+        }
+        return;
+    }
+
+    switch (lut->format)
+    {
+    case PIXEL_FORMAT_RGB565:
+    case PIXEL_FORMAT_RGB565_BE:
+    {
+        // byte-swapped pixels are looked up as loaded, the table is swapped instead
+        const uint16_t *px = (const uint16_t *)row + x0;
+        for (int x = 0; x < width; x++)
+        {
+            class_ids[x] = table[px[x]];
+        }
+        break;
+    }
+    case PIXEL_FORMAT_RGB888:
+    {
+        const uint8_t *px = row + 3 * x0;
+        for (int x = 0; x < width; x++, px += 3)
+        {
+            class_ids[x] = table[pixel_index_rgb888(px)];
+        }
+        break;
+    }
+    case PIXEL_FORMAT_YUV422:
+    {
+        int x = 0;
+        // a span starting on the second pixel of a pair
+        if (x0 & 1)
+        {
+            class_ids[x++] = table[pixel_format_index(PIXEL_FORMAT_YUV422, row, x0)];
+        }
+        const uint8_t *pair = row + 2 * (x0 + x);
+        for (; x + 1 < width; x += 2, pair += 4)
+        {
+            uint16_t uv = pixel_index_uv(pair[1], pair[3]);
+            class_ids[x] = table[pixel_index_yuv(pair[0], uv)];
+            class_ids[x + 1] = table[pixel_index_yuv(pair[2], uv)];
+        }
+        if (x < width)
+        {
+            class_ids[x] = table[pixel_index_yuv(pair[0], pixel_index_uv(pair[1], pair[3]))];
+        }
+        break;
+    }
+    default:
+        memset(class_ids, CLASS_NONE, width);
+        break;
+    }
+}
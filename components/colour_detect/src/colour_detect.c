@@ -0,0 +1,161 @@
+#include <stdio.h>
+#include <string.h>
+#include "detect_port.h"
+#include "colour_detect.h"
+#include "detect_prof.h"
+
+static const char *TAG = "colour_detect";
+
+int colour_registry_load(colour_registry_t *reg, const char *text)
+{
+    memset(reg, 0, sizeof(*reg));
+    int line_no = 0;
+
+    while (*text != '\0')
+    {
+        const char *end = strchr(text, '\n');
+        size_t len = end != NULL ? (size_t)(end - text) : strlen(text);
+        char line[128];
+        line_no++;
+
+        if (len >= sizeof(line))
+        {
+            ESP_LOGE(TAG, "Colour table line %d is too long", line_no);
+            return -1;
+        }
+        memcpy(line, text, len);
+        line[len] = '\0';
+        text += end != NULL ? len + 1 : len;
+
+        const char *p = line;
+        while (*p == ' ' || *p == '\t' || *p == '\r')
+            p++;
+        if (*p == '\0' || *p == '#')
+            continue;
+
+        if (reg->count == CLASS_LUT_MAX_CLASSES)
+        {
+            ESP_LOGE(TAG, "Colour table has more than %d classes", CLASS_LUT_MAX_CLASSES);
+            return -1;
+        }
+
+        colour_class_t *cls = &reg->classes[reg->count];
+        unsigned int h_min, h_max, s_min, s_max, v_min, v_max;
+        int fields = sscanf(p, "%15s %u %u %u %u %u %u %f %f %f", cls->name, &h_min, &h_max,
+                            &s_min, &s_max, &v_min, &v_max, &cls->min_percent,
+                            &cls->aspect_min, &cls->aspect_max);
+        if ((fields != 8 && fields != 10) || h_max > 255 || s_max > 255 || v_max > 255)
+        {
+            ESP_LOGE(TAG, "Malformed colour table line %d: %s", line_no, p);
+            return -1;
+        }
+        if (fields == 8)
+        {
+            cls->aspect_min = 0.0f;
+            cls->aspect_max = 0.0f;
+        }
+        cls->thresh.h_min = (uint8_t)h_min;
+        cls->thresh.h_max = (uint8_t)h_max;
+        cls->thresh.s_min = (uint8_t)s_min;
+        cls->thresh.s_max = (uint8_t)s_max;
+        cls->thresh.v_min = (uint8_t)v_min;
+        cls->thresh.v_max = (uint8_t)v_max;
+        reg->count++;
+    }
+    return reg->count;
+}
+
+void colour_registry_thresholds(const colour_registry_t *reg, color_threshold_t *thresholds)
+{
+    for (int c = 0; c < reg->count; c++)
+    {
+        thresholds[c] = reg->classes[c].thresh;
+    }
+}
+
+void frame_result_reset(frame_result_t *result, int class_count, int min_pixels)
+{
+    memset(result, 0, sizeof(*result));
+    result->class_count = class_count;
+    result->min_pixels = min_pixels;
+    for (int c = 0; c < class_count; c++)
+    {
+        result->classes[c].detected_blob = -1;
+    }
+}
+
+void frame_result_add(void *ctx, const blob_label_stats_t *stats)
+{
+    frame_result_t *result = (frame_result_t *)ctx;
+    class_result_t *cls = &result->classes[stats->class_id - 1];
+
+    cls->pixel_count += stats->pixel_count;
+    if (stats->pixel_count < result->min_pixels)
+    {
+        DETECT_PROF_BLOB(stats, false);
+        cls->rejected_count++;
+        return;
+    }
+    DETECT_PROF_BLOB(stats, true);
+
+    // insertion by first pixel; in-order input always appends
+    int pos = cls->blob_count;
+    while (pos > 0 && cls->blobs[pos - 1].first > stats->first)
+        pos--;
+    if (pos >= DETECT_MAX_BLOBS)
+    {
+        cls->dropped_count++;
+        return;
+    }
+    if (cls->blob_count == DETECT_MAX_BLOBS)
+    {
+        cls->blob_count--;
+        cls->dropped_count++;
+    }
+    memmove(&cls->blobs[pos + 1], &cls->blobs[pos], (cls->blob_count - pos) * sizeof(ranked_blob_t));
+    cls->blobs[pos].first = stats->first;
+    blob_label_to_blob(stats, &cls->blobs[pos].blob);
+    cls->blob_count++;
+}
+
+void frame_result_add_all(frame_result_t *result, blob_labeler_t *lab)
+{
+    int cursor = 0;
+    const blob_label_stats_t *stats;
+    while ((stats = blob_labeler_next(lab, &cursor)) != NULL)
+    {
+        frame_result_add(result, stats);
+    }
+}
+
+void colour_detect_evaluate(const colour_registry_t *reg, frame_result_t *result, int total_pixels)
+{
+    for (int c = 0; c < result->class_count; c++)
+    {
+        const colour_class_t *def = &reg->classes[c];
+        class_result_t *cls = &result->classes[c];
+
+        cls->percent = (float)cls->pixel_count / total_pixels * 100;
+        cls->detected = false;
+        cls->detected_blob = -1;
+        if (cls->percent < def->min_percent)
+            continue;
+
+        for (int i = 0; i < cls->blob_count; i++)
+        {
+            const blob_t *blob = &cls->blobs[i].blob;
+            if (def->aspect_max > 0.0f)
+            {
+                // Bird-like shape typically has aspect ratio between 0.5 and 2.0
+                int blob_width = blob->max_x - blob->min_x;
+                int blob_height = blob->max_y - blob->min_y;
+                float aspect_ratio = (float)blob_width / blob_height;
+                if (!(aspect_ratio > def->aspect_min && aspect_ratio < def->aspect_max))
+                    continue;
+            }
+            cls->detected = true;
+            cls->detected_blob = i;
+            break;
+        }
+    }
+}
@@ -0,0 +1,98 @@
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "detect_port.h"
+#include "coverage_gate.h"
+
+static const char *TAG = "coverage_gate";
+
+// Additive recurrence of the plastic number, the R2 low-discrepancy sequence
+#define R2_ALPHA_X 0.7548776662466927
+#define R2_ALPHA_Y 0.5698402909980532
+
+static int compare_index(const void *a, const void *b)
+{
+    uint32_t x = *(const uint32_t *)a;
+    uint32_t y = *(const uint32_t *)b;
+    return (x > y) - (x < y);
+}
+
+bool coverage_gate_init(coverage_gate_t *gate, int width, int height, int sample_count, float z)
+{
+    memset(gate, 0, sizeof(*gate));
+    // samples are packed as y << 16 | x
+    if (sample_count < 1 || width < 1 || height < 1 || width > 0xFFFF || height > 0xFFFF)
+    {
+        ESP_LOGE(TAG, "Unsupported gate of %d samples over %dx%d!", sample_count, width, height);
+        return false;
+    }
+    gate->width = width;
+    gate->height = height;
+    gate->sample_count = sample_count;
+    gate->z = z;
+    gate->samples = (uint32_t *)heap_caps_malloc(sample_count * sizeof(uint32_t),
+                                                 MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    if (gate->samples == NULL)
+    {
+        ESP_LOGE(TAG, "Failed to allocate %d samples!", sample_count);
+        return false;
+    }
+
+    for (int i = 0; i < sample_count; i++)
+    {
+        double u = fmod(0.5 + R2_ALPHA_X * (i + 1), 1.0);
+        double v = fmod(0.5 + R2_ALPHA_Y * (i + 1), 1.0);
+        uint32_t x = (uint32_t)(u * width);
+        uint32_t y = (uint32_t)(v * height);
+        gate->samples[i] = y << 16 | x;
+    }
+    // raster order, so the frame is read front to back
+    qsort(gate->samples, sample_count, sizeof(uint32_t), compare_index);
+    return true;
+}
+
+void coverage_gate_free(coverage_gate_t *gate)
+{
+    heap_caps_free(gate->samples);
+    gate->samples = NULL;
+}
+
+float coverage_gate_upper_bound(int hits, int n, float z)
+{
+    // Wilson score interval, stays meaningful at 0 hits unlike the normal one
+    float p = (float)hits / n;
+    float z2 = z * z;
+    float centre = p + z2 / (2.0f * n);
+    float spread = z * sqrtf(p * (1.0f - p) / n + z2 / (4.0f * n * n));
+    return (centre + spread) / (1.0f + z2 / n);
+}
+
+bool coverage_gate_check(coverage_gate_t *gate, const colour_registry_t *reg, const class_lut_t *lut,
+                         const pixel_frame_t *frame, frame_result_t *result)
+{
+    int hits[CLASS_LUT_MAX_CLASSES + 1] = {0};
+    for (int i = 0; i < gate->sample_count; i++)
+    {
+        uint32_t s = gate->samples[i];
+        hits[class_lut_lookup_at(lut, pixel_frame_row(frame, s >> 16), s & 0xFFFF)]++;
+    }
+
+    gate->frames++;
+    for (int c = 0; c < lut->class_count; c++)
+    {
+        float upper = coverage_gate_upper_bound(hits[c + 1], gate->sample_count, gate->z) * 100;
+        if (upper >= reg->classes[c].min_percent)
+            return false;
+    }
+
+    // Nothing can be detected; the sample counts scaled up stand in for the
+    // pixel counts so percent stays meaningful
+    int total_pixels = gate->width * gate->height;
+    for (int c = 0; c < lut->class_count; c++)
+    {
+        result->classes[c].pixel_count = (int)((int64_t)hits[c + 1] * total_pixels / gate->sample_count);
+    }
+    result->gated = true;
+    gate->skipped++;
+    return true;
+}
@@ -0,0 +1,92 @@
+#include <string.h>
+#include "detect_port.h"
+#include "detect_arena.h"
+
+static const char *TAG = "detect_arena";
+
+static bool region_init(detect_region_t *region, size_t size, uint32_t caps)
+{
+    region->size = size;
+    region->used = 0;
+    region->base = size > 0 ? (uint8_t *)heap_caps_malloc(size, caps) : NULL;
+    return size == 0 || region->base != NULL;
+}
+
+bool detect_arena_init(detect_arena_t *arena, size_t internal_bytes, size_t psram_bytes)
+{
+    memset(arena, 0, sizeof(*arena));
+    if (!region_init(&arena->internal, internal_bytes, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT) ||
+        !region_init(&arena->psram, psram_bytes, MALLOC_CAP_SPIRAM))
+    {
+        ESP_LOGE(TAG, "Failed to allocate arena of %zu internal / %zu PSRAM bytes!", internal_bytes,
+                 psram_bytes);
+        detect_arena_destroy(arena);
+        return false;
+    }
+    return true;
+}
+
+void detect_arena_destroy(detect_arena_t *arena)
+{
+    heap_caps_free(arena->internal.base);
+    heap_caps_free(arena->psram.base);
+    arena->internal.base = NULL;
+    arena->psram.base = NULL;
+}
+
+static bool region_owns(const detect_region_t *region, const void *ptr)
+{
+    const uint8_t *p = (const uint8_t *)ptr;
+    return region->base != NULL && p >= region->base && p < region->base + region->size;
+}
+
+void *detect_arena_alloc(detect_arena_t *arena, size_t size, uint32_t caps)
+{
+    if (arena == NULL)
+        return heap_caps_malloc(size, caps);
+
+    detect_region_t *region = (caps & MALLOC_CAP_SPIRAM) ? &arena->psram : &arena->internal;
+    size_t offset = (region->used + DETECT_ARENA_ALIGN - 1) & ~(size_t)(DETECT_ARENA_ALIGN - 1);
+    if (offset + size <= region->size)
+    {
+        region->used = offset + size;
+        return region->base + offset;
+    }
+
+    void *ptr = heap_caps_malloc(size, caps);
+    if (ptr != NULL)
+    {
+        arena->spilled_bytes += size;
+        arena->spilled_count++;
+    }
+    return ptr;
+}
+
+void *detect_arena_calloc(detect_arena_t *arena, size_t n, size_t size, uint32_t caps)
+{
+    void *ptr = detect_arena_alloc(arena, n * size, caps);
+    if (ptr != NULL)
+        memset(ptr, 0, n * size);
+    return ptr;
+}
+
+void *detect_arena_realloc(detect_arena_t *arena, void *ptr, size_t old_size, size_t size, uint32_t caps)
+{
+    if (arena == NULL)
+        return heap_caps_realloc(ptr, size, caps);
+
+    void *grown = detect_arena_alloc(arena, size, caps);
+    if (grown == NULL)
+        return NULL;
+    if (ptr != NULL)
+        memcpy(grown, ptr, old_size < size ? old_size : size);
+    detect_arena_free(arena, ptr);
+    return grown;
+}
+
+void detect_arena_free(detect_arena_t *arena, void *ptr)
+{
+    if (arena != NULL && (region_owns(&arena->internal, ptr) || region_owns(&arena->psram, ptr)))
+        return;
+    heap_caps_free(ptr);
+}
@@ -0,0 +1,149 @@
+// Host stand-ins for the ESP-IDF heap and timers, see detect_port.h
+#ifndef ESP_PLATFORM
+#include <stdbool.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <string.h>
+#include <time.h>
+#include "detect_port.h"
+
+#define HOST_INTERNAL_TOTAL (512 * 1024)
+#define HOST_PSRAM_TOTAL (8 * 1024 * 1024)
+
+// Each block carries its size and which budget it was charged to
+typedef struct
+{
+    size_t size;
+    size_t psram;
+    max_align_t align;
+} block_header_t;
+
+static port_heap_stats_t heap_stats;
+static pthread_mutex_t heap_lock = PTHREAD_MUTEX_INITIALIZER; // band workers allocate too
+
+static void charge(size_t size, bool psram)
+{
+    if (psram)
+    {
+        heap_stats.psram_in_use += size;
+        if (heap_stats.psram_in_use > heap_stats.psram_peak)
+            heap_stats.psram_peak = heap_stats.psram_in_use;
+    }
+    else
+    {
+        heap_stats.internal_in_use += size;
+        if (heap_stats.internal_in_use > heap_stats.internal_peak)
+            heap_stats.internal_peak = heap_stats.internal_in_use;
+    }
+}
+
+static void release(const block_header_t *header)
+{
+    if (header->psram)
+        heap_stats.psram_in_use -= header->size;
+    else
+        heap_stats.internal_in_use -= header->size;
+}
+
+void *heap_caps_malloc(size_t size, uint32_t caps)
+{
+    block_header_t *header = (block_header_t *)malloc(sizeof(block_header_t) + size);
+    if (header == NULL)
+        return NULL;
+    header->size = size;
+    header->psram = (caps & MALLOC_CAP_SPIRAM) != 0;
+    pthread_mutex_lock(&heap_lock);
+    charge(size, header->psram);
+    heap_stats.alloc_count++;
+    pthread_mutex_unlock(&heap_lock);
+    return header + 1;
+}
+
+void *heap_caps_calloc(size_t n, size_t size, uint32_t caps)
+{
+    void *ptr = heap_caps_malloc(n * size, caps);
+    if (ptr != NULL)
+        memset(ptr, 0, n * size);
+    return ptr;
+}
+
+void *heap_caps_realloc(void *ptr, size_t size, uint32_t caps)
+{
+    if (ptr == NULL)
+        return heap_caps_malloc(size, caps);
+
+    block_header_t *old = (block_header_t *)ptr - 1;
+    block_header_t saved = *old;
+    block_header_t *header = (block_header_t *)realloc(old, sizeof(block_header_t) + size);
+    if (header == NULL)
+        return NULL;
+    header->size = size;
+    header->psram = (caps & MALLOC_CAP_SPIRAM) != 0;
+    pthread_mutex_lock(&heap_lock);
+    release(&saved);
+    charge(size, header->psram);
+    heap_stats.alloc_count++;
+    pthread_mutex_unlock(&heap_lock);
+    return header + 1;
+}
+
+void heap_caps_free(void *ptr)
+{
+    if (ptr == NULL)
+        return;
+    block_header_t *header = (block_header_t *)ptr - 1;
+    pthread_mutex_lock(&heap_lock);
+    release(header);
+    pthread_mutex_unlock(&heap_lock);
+    free(header);
+}
+
+size_t heap_caps_get_total_size(uint32_t caps)
+{
+    return (caps & MALLOC_CAP_SPIRAM) ? HOST_PSRAM_TOTAL : HOST_INTERNAL_TOTAL;
+}
+
+size_t heap_caps_get_free_size(uint32_t caps)
+{
+    if (caps & MALLOC_CAP_SPIRAM)
+        return HOST_PSRAM_TOTAL - heap_stats.psram_in_use;
+    return HOST_INTERNAL_TOTAL - heap_stats.internal_in_use;
+}
+
+size_t heap_caps_get_minimum_free_size(uint32_t caps)
+{
+    if (caps & MALLOC_CAP_SPIRAM)
+        return HOST_PSRAM_TOTAL - heap_stats.psram_peak;
+    return HOST_INTERNAL_TOTAL - heap_stats.internal_peak;
+}
+
+void port_heap_stats(port_heap_stats_t *stats)
+{
+    pthread_mutex_lock(&heap_lock);
+    *stats = heap_stats;
+    pthread_mutex_unlock(&heap_lock);
+}
+
+void port_heap_reset_peak(void)
+{
+    pthread_mutex_lock(&heap_lock);
+    heap_stats.internal_peak = heap_stats.internal_in_use;
+    heap_stats.psram_peak = heap_stats.psram_in_use;
+    heap_stats.alloc_count = 0;
+    pthread_mutex_unlock(&heap_lock);
+}
+
+int64_t esp_timer_get_time(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+uint32_t port_ticks(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t)((uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec);
+}
+#endif
@@ -0,0 +1,208 @@
+#include <stdio.h>
+#include <string.h>
+#include "detect_port.h"
+#include "detect_prof.h"
+
+static const char *TAG = "detect_prof";
+
+static const char *const stage_names[DETECT_STAGE_COUNT] = {"gate", "classify", "label", "evaluate", "frame"};
+static const char *const counter_names[DETECT_COUNT_COUNT] = {"pixels_classified", "blobs_found",
+                                                             "blobs_rejected"};
+static const char *const memory_names[2] = {"internal", "psram"};
+
+// Profiler of the frame in flight, for records from deep inside the labelers
+static detect_prof_t *_Atomic active_prof;
+
+bool detect_prof_init(detect_prof_t *prof, int capacity)
+{
+    memset(prof, 0, sizeof(*prof));
+    uint32_t size = 1;
+    while (size < (uint32_t)capacity)
+        size <<= 1;
+    prof->records = (detect_record_t *)heap_caps_calloc(size, sizeof(detect_record_t),
+                                                        MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    if (prof->records == NULL)
+    {
+        ESP_LOGE(TAG, "Failed to allocate %u profile records!", (unsigned)size);
+        return false;
+    }
+    prof->capacity = size;
+    for (uint32_t i = 0; i < size; i++)
+    {
+        atomic_init(&prof->records[i].seq, 0);
+    }
+    atomic_init(&prof->head, 0);
+    atomic_init(&prof->tail, 0);
+    atomic_init(&prof->dropped, 0);
+    return true;
+}
+
+void detect_prof_free(detect_prof_t *prof)
+{
+    detect_prof_t *expected = prof;
+    atomic_compare_exchange_strong(&active_prof, &expected, NULL);
+    heap_caps_free(prof->records);
+    prof->records = NULL;
+}
+
+// Claims the next slot, NULL when the ring is full
+static detect_record_t *claim(detect_prof_t *prof, uint32_t *pos)
+{
+    uint32_t head = atomic_load_explicit(&prof->head, memory_order_relaxed);
+    do
+    {
+        if (head - atomic_load_explicit(&prof->tail, memory_order_acquire) >= prof->capacity)
+        {
+            atomic_fetch_add_explicit(&prof->dropped, 1, memory_order_relaxed);
+            return NULL;
+        }
+    } while (!atomic_compare_exchange_weak_explicit(&prof->head, &head, head + 1,
+                                                    memory_order_relaxed, memory_order_relaxed));
+    *pos = head;
+    return &prof->records[head & (prof->capacity - 1)];
+}
+
+static void push(detect_prof_t *prof, uint8_t kind, uint8_t id, uint32_t value, uint16_t x, uint16_t y,
+                 bool accepted)
+{
+    uint32_t pos;
+    detect_record_t *record = claim(prof, &pos);
+    if (record == NULL)
+        return;
+    record->frame = prof->frame;
+    record->kind = kind;
+    record->id = id;
+    record->accepted = accepted;
+    record->value = value;
+    record->x = x;
+    record->y = y;
+    atomic_store_explicit(&record->seq, pos + 1, memory_order_release);
+}
+
+static const uint32_t memory_caps[2] = {MALLOC_CAP_INTERNAL, MALLOC_CAP_SPIRAM};
+
+// Free heap now, folded into the frame's minimum; on target
+// heap_caps_get_minimum_free_size is a low-water mark since boot instead
+static void sample_heap(detect_prof_t *prof)
+{
+    for (int i = 0; i < 2; i++)
+    {
+        size_t free_bytes = heap_caps_get_free_size(memory_caps[i]);
+        if (free_bytes < prof->min_free[i])
+            prof->min_free[i] = free_bytes;
+    }
+}
+
+void detect_prof_frame_begin(detect_prof_t *prof)
+{
+    if (prof == NULL)
+        return;
+    prof->frame++;
+    prof->min_free[0] = SIZE_MAX;
+    prof->min_free[1] = SIZE_MAX;
+    sample_heap(prof);
+    atomic_store(&active_prof, prof);
+}
+
+void detect_prof_frame_end(detect_prof_t *prof)
+{
+    if (prof == NULL)
+        return;
+    atomic_store(&active_prof, NULL);
+
+    sample_heap(prof);
+    for (int i = 0; i < 2; i++)
+    {
+        push(prof, DETECT_RECORD_MEMORY, i, heap_caps_get_total_size(memory_caps[i]) - prof->min_free[i], 0, 0,
+             false);
+    }
+}
+
+uint32_t detect_prof_end(detect_prof_t *prof, const detect_prof_scope_t *scope)
+{
+    uint32_t ticks = port_ticks() - scope->start;
+    if (prof != NULL)
+    {
+        push(prof, DETECT_RECORD_STAGE, scope->stage, ticks, 0, 0, false);
+        sample_heap(prof);
+    }
+    return ticks;
+}
+
+void detect_prof_count(detect_prof_t *prof, detect_counter_t counter, uint32_t value)
+{
+    if (prof != NULL)
+        push(prof, DETECT_RECORD_COUNT, counter, value, 0, 0, false);
+}
+
+#if DETECT_PROF_BLOBS
+void detect_prof_blob(const blob_label_stats_t *stats, bool accepted)
+{
+    detect_prof_t *prof = atomic_load_explicit(&active_prof, memory_order_acquire);
+    if (prof != NULL)
+        push(prof, DETECT_RECORD_BLOB, stats->class_id, stats->pixel_count,
+             stats->sum_x / stats->pixel_count, stats->sum_y / stats->pixel_count, accepted);
+}
+#endif
+
+static void print_record(const detect_record_t *r, detect_prof_format_t format)
+{
+    double us = (double)r->value / port_ticks_per_us();
+    bool json = format == DETECT_PROF_JSON;
+    switch (r->kind)
+    {
+    case DETECT_RECORD_STAGE:
+        if (json)
+            printf("{\"frame\":%u,\"stage\":\"%s\",\"ticks\":%u,\"us\":%.3f}\n",
+                   (unsigned)r->frame, stage_names[r->id], (unsigned)r->value, us);
+        else
+            printf("prof frame %u stage %s %.3f ms\n", (unsigned)r->frame, stage_names[r->id], us / 1000.0);
+        break;
+    case DETECT_RECORD_COUNT:
+        if (json)
+            printf("{\"frame\":%u,\"counter\":\"%s\",\"value\":%u}\n",
+                   (unsigned)r->frame, counter_names[r->id], (unsigned)r->value);
+        else
+            printf("prof frame %u count %s %u\n", (unsigned)r->frame, counter_names[r->id], (unsigned)r->value);
+        break;
+    case DETECT_RECORD_MEMORY:
+        if (json)
+            printf("{\"frame\":%u,\"peak\":\"%s\",\"bytes\":%u}\n",
+                   (unsigned)r->frame, memory_names[r->id], (unsigned)r->value);
+        else
+            printf("prof frame %u peak %s %u bytes\n", (unsigned)r->frame, memory_names[r->id], (unsigned)r->value);
+        break;
+    case DETECT_RECORD_BLOB:
+        if (json)
+            printf("{\"frame\":%u,\"blob\":%u,\"pixels\":%u,\"x\":%u,\"y\":%u,\"accepted\":%s}\n",
+                   (unsigned)r->frame, r->id, (unsigned)r->value, r->x, r->y, r->accepted ? "true" : "false");
+        else
+            printf("prof frame %u blob class %u %u pixels at [%u,%u] %s\n", (unsigned)r->frame, r->id,
+                   (unsigned)r->value, r->x, r->y, r->accepted ? "kept" : "ignored");
+        break;
+    }
+}
+
+void detect_prof_dump(detect_prof_t *prof, detect_prof_format_t format)
+{
+    uint32_t tail = atomic_load_explicit(&prof->tail, memory_order_relaxed);
+    while (true)
+    {
+        detect_record_t *record = &prof->records[tail & (prof->capacity - 1)];
+        // a claimed slot that is not published yet ends the dump
+        if (atomic_load_explicit(&record->seq, memory_order_acquire) != tail + 1)
+            break;
+        print_record(record, format);
+        tail++;
+        atomic_store_explicit(&prof->tail, tail, memory_order_release);
+    }
+
+    uint32_t dropped = atomic_exchange_explicit(&prof->dropped, 0, memory_order_relaxed);
+    if (dropped > 0)
+    {
+        if (format == DETECT_PROF_JSON)
+            printf("{\"frame\":%u,\"dropped\":%u}\n", (unsigned)prof->frame, (unsigned)dropped);
+        else
+            printf("prof frame %u dropped %u records\n", (unsigned)prof->frame, (unsigned)dropped);
+    }
+}
@@ -0,0 +1,440 @@
+#include <string.h>
+#include "detect_port.h"
+#include "blob_label.h"
+#include "detector.h"
+
+static const char *TAG = "detector";
+
+// Per labeler: the run ring, label table and active list at their initial
+// size, with room to double a few times (grown tables leave the old ones
+// behind in the arena)
+#define LABELER_INTERNAL_BYTES (64 * 1024)
+#define LABELER_PSRAM_BYTES (256 * 1024)
+// stitching table of the parallel pipeline
+#define MERGED_PSRAM_BYTES (256 * 1024)
+
+void detector_default_budget(const detector_config_t *cfg, const class_lut_t *lut, detector_budget_t *budget)
+{
+    size_t frame_bytes = (size_t)cfg->width * cfg->height;
+    int labelers = 1;
+    budget->internal_bytes = cfg->width;
+    budget->psram_bytes = 0;
+
+    switch (cfg->pipeline)
+    {
+    case DETECTOR_FULL_FRAME:
+        budget->psram_bytes = frame_bytes;
+        break;
+    case DETECTOR_PARALLEL:
+        labelers = cfg->workers < 1 ? 1 : cfg->workers > WORKER_POOL_MAX ? WORKER_POOL_MAX : cfg->workers;
+        // band head rows: max_gap rows of at most width / 2 runs each
+        budget->psram_bytes = frame_bytes + MERGED_PSRAM_BYTES +
+                              (size_t)labelers * cfg->max_gap * ((cfg->width + 1) / 2) * sizeof(blob_run_t);
+        break;
+    case DETECTOR_STREAMING:
+        break;
+    case DETECTOR_PYRAMID:
+        labelers = 2;
+        // coarse map, one byte per cell
+        budget->psram_bytes = (size_t)((cfg->width + cfg->pyramid_factor - 1) / cfg->pyramid_factor) *
+                              ((cfg->height + cfg->pyramid_factor - 1) / cfg->pyramid_factor);
+        break;
+    case DETECTOR_MORPH:
+        // class masks plus the bridged one
+        budget->psram_bytes = (size_t)(lut->class_count + 1) *
+                              ((cfg->width + PIXEL_MASK_WORD_BITS - 1) / PIXEL_MASK_WORD_BITS) * cfg->height *
+                              sizeof(uint32_t);
+        break;
+    }
+    budget->internal_bytes += (size_t)labelers * LABELER_INTERNAL_BYTES;
+    budget->psram_bytes += (size_t)labelers * LABELER_PSRAM_BYTES;
+}
+
+bool detector_init(detector_t *det, const detector_config_t *cfg, const class_lut_t *lut,
+                   const detector_budget_t *budget)
+{
+    memset(det, 0, sizeof(*det));
+    det->config = *cfg;
+    // the gate's samples are coordinates in a frame of its own size
+    if (cfg->gate != NULL && (cfg->gate->width != cfg->width || cfg->gate->height != cfg->height))
+    {
+        ESP_LOGE(TAG, "Coverage gate is for %dx%d frames, detector for %dx%d!", cfg->gate->width,
+                 cfg->gate->height, cfg->width, cfg->height);
+        return false;
+    }
+    if (cfg->max_gap < 1)
+    {
+        ESP_LOGE(TAG, "Gap of %d pixels, need at least 1!", cfg->max_gap);
+        return false;
+    }
+    // a capped gap box would bridge less than the other pipelines do
+    if (cfg->pipeline == DETECTOR_MORPH && cfg->max_gap > PIXEL_MORPH_MAX_GAP)
+    {
+        ESP_LOGE(TAG, "The morph pipeline bridges gaps of at most %d, not %d!", PIXEL_MORPH_MAX_GAP, cfg->max_gap);
+        return false;
+    }
+
+    detector_budget_t default_budget;
+    if (budget == NULL)
+    {
+        detector_default_budget(cfg, lut, &default_budget);
+        budget = &default_budget;
+    }
+    if (!detect_arena_init(&det->arena, budget->internal_bytes, budget->psram_bytes))
+        return false;
+
+    bool ok = true;
+    switch (cfg->pipeline)
+    {
+    case DETECTOR_FULL_FRAME:
+    case DETECTOR_PARALLEL:
+        // One class id per pixel for every class, in PSRAM
+        det->class_map = (uint8_t *)detect_arena_alloc(&det->arena, (size_t)cfg->width * cfg->height,
+                                                       MALLOC_CAP_SPIRAM);
+        ok = det->class_map != NULL;
+        if (ok && cfg->pipeline == DETECTOR_PARALLEL)
+            ok = frame_parallel_init(&det->parallel, cfg->width, cfg->height, cfg->max_gap, cfg->workers,
+                                     &det->arena);
+        else if (ok)
+            ok = blob_labeler_init_in(&det->labeler, cfg->width, cfg->height, cfg->max_gap, &det->arena);
+        break;
+    case DETECTOR_STREAMING:
+        ok = frame_stream_init(&det->stream, cfg->width, cfg->height, cfg->max_gap, cfg->min_pixels, lut,
+                               &det->arena);
+        break;
+    case DETECTOR_PYRAMID:
+        ok = frame_pyramid_init(&det->pyramid, cfg->width, cfg->height, cfg->max_gap, cfg->min_pixels,
+                                cfg->pyramid_factor, &det->arena);
+        break;
+    case DETECTOR_MORPH:
+        // the bridged mask only needs 8-connectivity, so the labeler holds two rows
+        ok = pixel_mask_init_in(&det->bridged, cfg->width, cfg->height, MALLOC_CAP_SPIRAM, &det->arena) &&
+             blob_labeler_init_in(&det->labeler, cfg->width, cfg->height, 1, &det->arena) &&
+             blob_labeler_set_retire(&det->labeler, frame_result_add, NULL);
+        for (int c = 0; ok && c < lut->class_count; c++)
+        {
+            ok = pixel_mask_init_in(&det->masks[c], cfg->width, cfg->height, MALLOC_CAP_SPIRAM, &det->arena);
+            det->mask_count += ok;
+        }
+        break;
+    }
+    if (!ok)
+    {
+        ESP_LOGE(TAG, "Failed to set up the %s pipeline!", detector_pipeline_name(cfg->pipeline));
+        detector_free(det);
+        return false;
+    }
+    return true;
+}
+
+void detector_free(detector_t *det)
+{
+    switch (det->config.pipeline)
+    {
+    case DETECTOR_FULL_FRAME:
+        blob_labeler_free(&det->labeler);
+        break;
+    case DETECTOR_PARALLEL:
+        frame_parallel_free(&det->parallel);
+        break;
+    case DETECTOR_STREAMING:
+        frame_stream_free(&det->stream);
+        break;
+    case DETECTOR_PYRAMID:
+        frame_pyramid_free(&det->pyramid);
+        break;
+    case DETECTOR_MORPH:
+        blob_labeler_free(&det->labeler);
+        pixel_mask_free(&det->bridged);
+        for (int c = 0; c < det->mask_count; c++)
+        {
+            pixel_mask_free(&det->masks[c]);
+        }
+        det->mask_count = 0;
+        break;
+    }
+    detect_arena_destroy(&det->arena);
+    det->class_map = NULL;
+}
+
+// Rows are classified and labeled as they arrive; only a row of class ids
+// and the labeler's last max_gap rows of runs are held
+static bool process_streaming(detector_t *det, const class_lut_t *lut, const pixel_frame_t *frame,
+                              frame_result_t *result)
+{
+    const detector_config_t *cfg = &det->config;
+    frame_stream_t *fs = &det->stream;
+    int chunk_rows = cfg->chunk_rows > 0 ? cfg->chunk_rows : 1;
+    bool ok = true;
+
+    fs->lut = lut;
+    frame_stream_begin(fs);
+    for (int y = 0; y < cfg->height; y += chunk_rows)
+    {
+        int rows = cfg->height - y < chunk_rows ? cfg->height - y : chunk_rows;
+        if (!frame_stream_push_rows(fs, pixel_frame_row(frame, y), frame->stride, rows))
+        {
+            ESP_LOGE(TAG, "Streaming ran out of memory at row %d!", y);
+            ok = false;
+            break;
+        }
+    }
+    *result = fs->result;
+    return ok;
+}
+
+// Label every class of the class map in one sweep
+static bool process_class_map(detector_t *det, frame_result_t *result)
+{
+    const detector_config_t *cfg = &det->config;
+    blob_labeler_t *labeler = &det->labeler;
+    bool ok = true;
+
+    blob_labeler_reset(labeler, 0);
+    for (int y = 0; y < cfg->height; y++)
+    {
+        if (!blob_labeler_push_class_row(labeler, det->class_map + (size_t)y * cfg->width))
+        {
+            ESP_LOGE(TAG, "Blob labeling ran out of memory at row %d!", y);
+            ok = false;
+            break;
+        }
+    }
+    frame_result_add_all(result, labeler);
+    return ok;
+}
+
+// Each class's mask is opened against speckle if configured, dilated by the
+// gap box and labeled with 8-connectivity; the statistics come from the
+// undilated mask, so the blobs are those of the max_gap labeling
+static bool process_masks(detector_t *det, int class_count, frame_result_t *result)
+{
+    const detector_config_t *cfg = &det->config;
+    blob_labeler_t *labeler = &det->labeler;
+    pixel_morph_box_t box = pixel_morph_gap_box(cfg->max_gap);
+
+    blob_labeler_set_retire(labeler, frame_result_add, result);
+    for (int c = 0; c < class_count; c++)
+    {
+        pixel_mask_t *mask = &det->masks[c];
+        if (cfg->denoise_radius > 0)
+            pixel_morph_open(mask, &det->bridged, cfg->denoise_radius);
+        pixel_morph_dilate_box(mask, &det->bridged, box);
+
+        blob_labeler_reset(labeler, 0);
+        for (int y = 0; y < cfg->height; y++)
+        {
+            if (!blob_labeler_push_bridged_row(labeler, pixel_mask_row(&det->bridged, y), pixel_mask_row(mask, y),
+                                               c + 1))
+            {
+                ESP_LOGE(TAG, "Blob labeling ran out of memory at row %d!", y);
+                return false;
+            }
+        }
+        blob_labeler_flush(labeler);
+    }
+    return true;
+}
+
+// Classification and labeling of one frame by the configured pipeline
+static bool run_pipeline(detector_t *det, const class_lut_t *lut, const pixel_frame_t *frame,
+                         frame_result_t *result, detector_timing_t *t, uint32_t *classified)
+{
+    const detector_config_t *cfg = &det->config;
+    bool ok;
+
+    *classified = cfg->width * cfg->height;
+    if (cfg->pipeline == DETECTOR_STREAMING || cfg->pipeline == DETECTOR_PYRAMID)
+    {
+        detect_prof_scope_t label = detect_prof_begin(DETECT_STAGE_LABEL);
+        if (cfg->pipeline == DETECTOR_STREAMING)
+        {
+            ok = process_streaming(det, lut, frame, result);
+        }
+        else
+        {
+            // Coarse pass first, then full resolution only inside the candidate boxes
+            frame_pyramid_t *fp = &det->pyramid;
+            ok = frame_pyramid_process(fp, frame, lut, result);
+            *classified = fp->coarse_width * fp->coarse_height + fp->refined_pixels;
+        }
+        t->label_us = detect_prof_us(detect_prof_end(cfg->prof, &label));
+        return ok;
+    }
+
+    frame_result_reset(result, lut->class_count, cfg->min_pixels);
+    if (cfg->pipeline == DETECTOR_PARALLEL)
+    {
+        // Each band is classified and labeled on its own core, then stitched
+        detect_prof_scope_t label = detect_prof_begin(DETECT_STAGE_LABEL);
+        ok = frame_parallel_process(&det->parallel, frame, lut, det->class_map, result);
+        if (!ok)
+            ESP_LOGE(TAG, "Parallel frame processing failed!");
+        t->label_us = detect_prof_us(detect_prof_end(cfg->prof, &label));
+        return ok;
+    }
+
+    detect_prof_scope_t classify = detect_prof_begin(DETECT_STAGE_CLASSIFY);
+    for (int y = 0; y < cfg->height; y++)
+    {
+        if (cfg->pipeline == DETECTOR_MORPH)
+            class_lut_classify_row(lut, pixel_frame_row(frame, y), y, det->masks);
+        else
+            class_lut_classify_ids(lut, pixel_frame_row(frame, y), 0, cfg->width,
+                                   det->class_map + (size_t)y * cfg->width);
+    }
+    t->classify_us = detect_prof_us(detect_prof_end(cfg->prof, &classify));
+
+    detect_prof_scope_t label = detect_prof_begin(DETECT_STAGE_LABEL);
+    if (cfg->pipeline == DETECTOR_MORPH)
+        ok = process_masks(det, lut->class_count, result);
+    else
+        ok = process_class_map(det, result);
+    t->label_us = detect_prof_us(detect_prof_end(cfg->prof, &label));
+    return ok;
+}
+
+// Pixel and blob counters of a finished frame
+static void count_frame(detect_prof_t *prof, const frame_result_t *result, uint32_t classified)
+{
+    uint32_t found = 0;
+    uint32_t rejected = 0;
+    for (int c = 0; c < result->class_count; c++)
+    {
+        found += result->classes[c].blob_count + result->classes[c].dropped_count;
+        rejected += result->classes[c].rejected_count;
+    }
+    detect_prof_count(prof, DETECT_COUNT_PIXELS_CLASSIFIED, classified);
+    detect_prof_count(prof, DETECT_COUNT_BLOBS_FOUND, found);
+    detect_prof_count(prof, DETECT_COUNT_BLOBS_REJECTED, rejected);
+}
+
+// Per-class decision, frame timer and counters, shared by every kind of input
+static void finish_frame(detector_t *det, const colour_registry_t *reg, frame_result_t *result,
+                         detector_timing_t *t, detect_prof_scope_t *whole, uint32_t classified,
+                         detector_timing_t *timing)
+{
+    const detector_config_t *cfg = &det->config;
+    detect_prof_scope_t evaluate = detect_prof_begin(DETECT_STAGE_EVALUATE);
+    colour_detect_evaluate(reg, result, cfg->width * cfg->height);
+    t->evaluate_us = detect_prof_us(detect_prof_end(cfg->prof, &evaluate));
+    t->total_us = detect_prof_us(detect_prof_end(cfg->prof, whole));
+
+    if (cfg->prof != NULL)
+    {
+        count_frame(cfg->prof, result, classified);
+        detect_prof_frame_end(cfg->prof);
+    }
+    if (timing != NULL)
+        *timing = *t;
+}
+
+bool detector_run(detector_t *det, const colour_registry_t *reg, const class_lut_t *lut,
+                  const pixel_frame_t *frame, frame_result_t *result, detector_timing_t *timing)
+{
+    const detector_config_t *cfg = &det->config;
+    if (frame->width != cfg->width || frame->height != cfg->height || frame->format != lut->format)
+    {
+        ESP_LOGE(TAG, "%dx%d %s frame does not fit a %dx%d detector with a %s class table!", frame->width,
+                 frame->height, pixel_format_name(frame->format), cfg->width, cfg->height,
+                 pixel_format_name(lut->format));
+        return false;
+    }
+    if (cfg->pipeline == DETECTOR_MORPH && lut->class_count > det->mask_count)
+    {
+        ESP_LOGE(TAG, "%d classes but masks for %d!", lut->class_count, det->mask_count);
+        return false;
+    }
+
+    detector_timing_t t;
+    memset(&t, 0, sizeof(t));
+    detect_prof_frame_begin(cfg->prof);
+    detect_prof_scope_t whole = detect_prof_begin(DETECT_STAGE_FRAME);
+    uint32_t classified = 0;
+    bool skip = false;
+    bool ok = true;
+
+    // A frame the gate rules out keeps its estimated counts and no blobs
+    if (cfg->gate != NULL)
+    {
+        detect_prof_scope_t gate = detect_prof_begin(DETECT_STAGE_GATE);
+        frame_result_reset(result, lut->class_count, cfg->min_pixels);
+        skip = coverage_gate_check(cfg->gate, reg, lut, frame, result);
+        t.gate_us = detect_prof_us(detect_prof_end(cfg->prof, &gate));
+        classified = cfg->gate->sample_count;
+    }
+    if (!skip)
+    {
+        uint32_t pipeline_classified;
+        ok = run_pipeline(det, lut, frame, result, &t, &pipeline_classified);
+        classified += pipeline_classified;
+    }
+
+    finish_frame(det, reg, result, &t, &whole, classified, timing);
+    return ok;
+}
+
+bool detector_run_tiled(detector_t *det, const colour_registry_t *reg, const class_lut_t *lut,
+                        const tiled_image_t *image, frame_result_t *result, detector_timing_t *timing,
+                        tiled_image_stats_t *stats)
+{
+    const detector_config_t *cfg = &det->config;
+    if (cfg->pipeline != DETECTOR_FULL_FRAME || image->width != cfg->width || image->height != cfg->height ||
+        image->format != lut->format)
+    {
+        ESP_LOGE(TAG, "%dx%d %s tiled image does not fit a %dx%d %s detector with a %s class table!",
+                 image->width, image->height, pixel_format_name(image->format), cfg->width, cfg->height,
+                 detector_pipeline_name(cfg->pipeline), pixel_format_name(lut->format));
+        return false;
+    }
+
+    detector_timing_t t;
+    tiled_image_stats_t tile_stats;
+    memset(&t, 0, sizeof(t));
+    detect_prof_frame_begin(cfg->prof);
+    detect_prof_scope_t whole = detect_prof_begin(DETECT_STAGE_FRAME);
+    frame_result_reset(result, lut->class_count, cfg->min_pixels);
+
+    detect_prof_scope_t classify = detect_prof_begin(DETECT_STAGE_CLASSIFY);
+    tiled_image_classify(image, lut, det->class_map, &tile_stats);
+    t.classify_us = detect_prof_us(detect_prof_end(cfg->prof, &classify));
+
+    detect_prof_scope_t label = detect_prof_begin(DETECT_STAGE_LABEL);
+    bool ok = process_class_map(det, result);
+    t.label_us = detect_prof_us(detect_prof_end(cfg->prof, &label));
+
+    finish_frame(det, reg, result, &t, &whole, tile_stats.classified_pixels, timing);
+    if (stats != NULL)
+        *stats = tile_stats;
+    return ok;
+}
+
+bool detector_process(const detector_config_t *cfg, const colour_registry_t *reg,
+                      const class_lut_t *lut, const pixel_frame_t *frame,
+                      frame_result_t *result, detector_timing_t *timing)
+{
+    detector_t det;
+    if (!detector_init(&det, cfg, lut, NULL))
+        return false;
+    bool ok = detector_run(&det, reg, lut, frame, result, timing);
+    detector_free(&det);
+    return ok;
+}
+
+const char *detector_pipeline_name(detector_pipeline_t pipeline)
+{
+    switch (pipeline)
+    {
+    case DETECTOR_FULL_FRAME:
+        return "full";
+    case DETECTOR_PARALLEL:
+        return "parallel";
+    case DETECTOR_STREAMING:
+        return "stream";
+    case DETECTOR_PYRAMID:
+        return "pyramid";
+    case DETECTOR_MORPH:
+        return "morph";
+    }
+    return "?";
+}
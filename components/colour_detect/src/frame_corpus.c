@@ -0,0 +1,251 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <dirent.h>
+#include "detect_port.h"
+#include "frame_corpus.h"
+
+static const char *TAG = "frame_corpus";
+
+static bool is_raw_name(const char *name)
+{
+    size_t len = strlen(name);
+    return len > 4 && strcasecmp(name + len - 4, ".raw") == 0;
+}
+
+static int compare_name(const void *a, const void *b)
+{
+    return strcmp((const char *)a, (const char *)b);
+}
+
+static int compare_latency(const void *a, const void *b)
+{
+    int64_t x = *(const int64_t *)a;
+    int64_t y = *(const int64_t *)b;
+    return (x > y) - (x < y);
+}
+
+static bool list_frames(frame_corpus_t *corpus)
+{
+    DIR *dir = opendir(corpus->dir);
+    if (dir == NULL)
+    {
+        ESP_LOGE(TAG, "Cannot open directory %s!", corpus->dir);
+        return false;
+    }
+
+    int capacity = 0;
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL)
+    {
+        if (!is_raw_name(entry->d_name))
+            continue;
+        if (strlen(entry->d_name) >= FRAME_CORPUS_NAME_LEN)
+        {
+            ESP_LOGW(TAG, "Name of %s/%s too long, skipped", corpus->dir, entry->d_name);
+            continue;
+        }
+        if (corpus->count == capacity)
+        {
+            // the list only grows while opening
+            capacity = capacity == 0 ? 64 : capacity * 2;
+            void *names = heap_caps_realloc(corpus->names, (size_t)capacity * FRAME_CORPUS_NAME_LEN,
+                                            MALLOC_CAP_SPIRAM);
+            if (names == NULL)
+            {
+                ESP_LOGE(TAG, "Failed to list %d frames!", capacity);
+                closedir(dir);
+                return false;
+            }
+            corpus->names = (char (*)[FRAME_CORPUS_NAME_LEN])names;
+        }
+        strcpy(corpus->names[corpus->count++], entry->d_name);
+    }
+    closedir(dir);
+
+    qsort(corpus->names, corpus->count, FRAME_CORPUS_NAME_LEN, compare_name);
+    return true;
+}
+
+static bool load_frame(const frame_corpus_t *corpus, int index, uint8_t *buffer)
+{
+    char path[FRAME_CORPUS_PATH_LEN + FRAME_CORPUS_NAME_LEN + 1];
+    snprintf(path, sizeof(path), "%s/%s", corpus->dir, corpus->names[index]);
+    FILE *f = fopen(path, "rb");
+    if (f == NULL)
+    {
+        ESP_LOGW(TAG, "Cannot open %s, skipped", path);
+        return false;
+    }
+    size_t got = fread(buffer, 1, corpus->frame_bytes, f);
+    bool exact = got == corpus->frame_bytes && fgetc(f) == EOF;
+    fclose(f);
+    if (!exact)
+    {
+        ESP_LOGW(TAG, "%s is not a %dx%d %s frame of %zu bytes, skipped", path, corpus->width, corpus->height,
+                 pixel_format_name(corpus->format), corpus->frame_bytes);
+    }
+    return exact;
+}
+
+// Fills the back buffer with the next readable frame; runs on the I/O
+// thread with prefetch, which alone touches the loader fields until waited for
+static void load_next(void *arg)
+{
+    frame_corpus_t *corpus = (frame_corpus_t *)arg;
+    int64_t t0 = esp_timer_get_time();
+    corpus->loaded = -1;
+    while (corpus->cursor < corpus->count)
+    {
+        int index = corpus->cursor++;
+        if (load_frame(corpus, index, corpus->buffers[corpus->back]))
+        {
+            corpus->loaded = index;
+            break;
+        }
+        corpus->failed++;
+    }
+    corpus->load_us += esp_timer_get_time() - t0;
+}
+
+static void start_load(frame_corpus_t *corpus)
+{
+    if (corpus->prefetch && corpus->cursor < corpus->count)
+    {
+        worker_pool_start(&corpus->io, load_next, corpus, 0);
+        corpus->pending = true;
+    }
+}
+
+bool frame_corpus_open(frame_corpus_t *corpus, const char *dir, pixel_format_t format, int width, int height,
+                       uint32_t caps, bool prefetch)
+{
+    memset(corpus, 0, sizeof(*corpus));
+    if (strlen(dir) >= FRAME_CORPUS_PATH_LEN || width <= 0 || height <= 0 ||
+        (format == PIXEL_FORMAT_YUV422 && width % 2 != 0))
+    {
+        ESP_LOGE(TAG, "Unsupported corpus %s of %dx%d %s!", dir, width, height, pixel_format_name(format));
+        return false;
+    }
+    strcpy(corpus->dir, dir);
+    corpus->format = format;
+    corpus->width = width;
+    corpus->height = height;
+    corpus->frame_bytes = (size_t)width * height * pixel_format_bytes(format);
+    corpus->prefetch = prefetch;
+    if (!list_frames(corpus))
+    {
+        frame_corpus_close(corpus);
+        return false;
+    }
+
+    corpus->latency_us = (int64_t *)heap_caps_calloc(corpus->count + 1, sizeof(int64_t), MALLOC_CAP_SPIRAM);
+    for (int i = 0; i < 2; i++)
+    {
+        corpus->buffers[i] = (uint8_t *)heap_caps_malloc(corpus->frame_bytes, caps);
+    }
+    if (corpus->latency_us == NULL || corpus->buffers[0] == NULL || corpus->buffers[1] == NULL)
+    {
+        ESP_LOGE(TAG, "Failed to allocate two %zu byte frame buffers!", corpus->frame_bytes);
+        frame_corpus_close(corpus);
+        return false;
+    }
+    if (prefetch && !worker_pool_init(&corpus->io, 1, FRAME_CORPUS_IO_STACK))
+    {
+        frame_corpus_close(corpus);
+        return false;
+    }
+
+    corpus->loaded = -1;
+    corpus->start_us = esp_timer_get_time();
+    corpus->end_us = corpus->start_us;
+    start_load(corpus);
+    return true;
+}
+
+void frame_corpus_close(frame_corpus_t *corpus)
+{
+    if (corpus->pending)
+        worker_pool_wait(&corpus->io);
+    corpus->pending = false;
+    if (corpus->io.done != NULL)
+        worker_pool_free(&corpus->io);
+    for (int i = 0; i < 2; i++)
+    {
+        heap_caps_free(corpus->buffers[i]);
+        corpus->buffers[i] = NULL;
+    }
+    heap_caps_free(corpus->latency_us);
+    heap_caps_free(corpus->names);
+    corpus->latency_us = NULL;
+    corpus->names = NULL;
+    corpus->count = 0;
+}
+
+bool frame_corpus_next(frame_corpus_t *corpus, pixel_frame_t *frame, const char **name)
+{
+    int64_t t0 = esp_timer_get_time();
+    if (corpus->pending)
+    {
+        worker_pool_wait(&corpus->io);
+        corpus->pending = false;
+    }
+    else if (!corpus->prefetch)
+    {
+        load_next(corpus);
+    }
+    corpus->end_us = esp_timer_get_time();
+    corpus->wait_us += corpus->end_us - t0;
+    if (corpus->loaded < 0)
+        return false;
+
+    // hand out the back buffer and refill the other one meanwhile; the
+    // caller is done with the frame it held there
+    int index = corpus->loaded;
+    uint8_t *pixels = corpus->buffers[corpus->back];
+    corpus->back ^= 1;
+    corpus->loaded = -1;
+    start_load(corpus);
+
+    corpus->unrecorded = true;
+    *name = corpus->names[index];
+    return pixel_frame_wrap(frame, pixels, corpus->format, corpus->width, corpus->height, 0);
+}
+
+void frame_corpus_record(frame_corpus_t *corpus, int64_t latency_us)
+{
+    if (!corpus->unrecorded)
+        return;
+    corpus->unrecorded = false;
+    corpus->latency_us[corpus->frames++] = latency_us;
+}
+
+void frame_corpus_fail(frame_corpus_t *corpus)
+{
+    if (!corpus->unrecorded)
+        return;
+    corpus->unrecorded = false;
+    corpus->errors++;
+}
+
+void frame_corpus_summarize(frame_corpus_t *corpus, frame_corpus_summary_t *summary)
+{
+    memset(summary, 0, sizeof(*summary));
+    int n = corpus->frames;
+    summary->frames = n;
+    summary->errors = corpus->errors;
+    summary->failed = corpus->failed;
+    summary->load_us = corpus->load_us;
+    summary->wait_us = corpus->wait_us;
+    if (n == 0)
+        return;
+
+    int64_t wall_us = corpus->end_us - corpus->start_us;
+    summary->fps = wall_us > 0 ? n * 1e6 / wall_us : 0;
+    qsort(corpus->latency_us, n, sizeof(int64_t), compare_latency);
+    summary->p50_us = corpus->latency_us[(n * 50 + 99) / 100 - 1];
+    summary->p90_us = corpus->latency_us[(n * 90 + 99) / 100 - 1];
+    summary->p99_us = corpus->latency_us[(n * 99 + 99) / 100 - 1];
+    summary->max_us = corpus->latency_us[n - 1];
+}
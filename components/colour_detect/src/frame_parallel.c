@@ -0,0 +1,173 @@
+#include <string.h>
+#include "detect_port.h"
+#include "frame_parallel.h"
+
+static const char *TAG = "frame_parallel";
+
+static void band_job(void *arg)
+{
+    frame_band_t *band = (frame_band_t *)arg;
+    int width = band->labeler.width;
+
+    band->ok = true;
+    blob_labeler_reset(&band->labeler, band->y0);
+
+    for (int y = band->y0; y < band->y1; y++)
+    {
+        uint8_t *class_row = band->class_map + (size_t)y * width;
+        class_lut_classify_ids(band->lut, pixel_frame_row(band->frame, y), 0, width, class_row);
+        if (!blob_labeler_push_class_row(&band->labeler, class_row))
+        {
+            band->ok = false;
+            return;
+        }
+    }
+}
+
+bool frame_parallel_init(frame_parallel_t *fp, int width, int height, int max_gap, int workers,
+                         detect_arena_t *arena)
+{
+    memset(fp, 0, sizeof(*fp));
+    fp->arena = arena;
+    fp->width = width;
+    fp->height = height;
+    fp->max_gap = max_gap;
+
+    if (workers > WORKER_POOL_MAX)
+        workers = WORKER_POOL_MAX;
+    while (workers > 1 && height / workers < max_gap)
+        workers--;
+    fp->band_count = workers;
+
+    if (!worker_pool_init(&fp->pool, workers, WORKER_POOL_DEFAULT_STACK))
+        return false;
+
+    int band_height = height / workers;
+    for (int b = 0; b < workers; b++)
+    {
+        frame_band_t *band = &fp->bands[b];
+        band->y0 = b * band_height;
+        band->y1 = b == workers - 1 ? height : band->y0 + band_height;
+        if (!blob_labeler_init_in(&band->labeler, width, height, max_gap, arena) ||
+            (b > 0 && !blob_labeler_keep_head(&band->labeler)))
+        {
+            ESP_LOGE(TAG, "Failed to set up band %d", b);
+            frame_parallel_free(fp);
+            return false;
+        }
+    }
+    return true;
+}
+
+void frame_parallel_free(frame_parallel_t *fp)
+{
+    if (fp->pool.count > 0)
+        worker_pool_free(&fp->pool);
+    for (int b = 0; b < fp->band_count; b++)
+    {
+        blob_labeler_free(&fp->bands[b].labeler);
+    }
+    detect_arena_free(fp->arena, fp->merged);
+    fp->merged = NULL;
+    fp->merged_capacity = 0;
+}
+
+// Joins the band label tables into one and unions every pair of same-class
+// runs that touch across a band boundary
+static bool stitch_bands(frame_parallel_t *fp)
+{
+    int total = 0;
+    int offsets[WORKER_POOL_MAX];
+    for (int b = 0; b < fp->band_count; b++)
+    {
+        offsets[b] = total;
+        total += fp->bands[b].labeler.label_count;
+    }
+
+    if (total > fp->merged_capacity)
+    {
+        detect_arena_free(fp->arena, fp->merged);
+        fp->merged = (blob_label_stats_t *)detect_arena_alloc(fp->arena, total * sizeof(blob_label_stats_t),
+                                                              MALLOC_CAP_SPIRAM);
+        fp->merged_capacity = fp->merged != NULL ? total : 0;
+        if (fp->merged == NULL)
+        {
+            ESP_LOGE(TAG, "Failed to allocate %d merged labels!", total);
+            return false;
+        }
+    }
+    fp->merged_count = total;
+
+    blob_label_stats_t *merged = fp->merged;
+    for (int b = 0; b < fp->band_count; b++)
+    {
+        blob_labeler_t *lab = &fp->bands[b].labeler;
+        for (int l = 0; l < lab->label_count; l++)
+        {
+            merged[offsets[b] + l] = lab->labels[l];
+            merged[offsets[b] + l].parent = offsets[b] + blob_label_find(lab->labels, l);
+        }
+    }
+
+    int gap = fp->max_gap;
+    for (int b = 0; b + 1 < fp->band_count; b++)
+    {
+        blob_labeler_t *upper = &fp->bands[b].labeler;
+        blob_labeler_t *lower = &fp->bands[b + 1].labeler;
+        int boundary = fp->bands[b + 1].y0;
+
+        for (int ty = boundary - gap; ty < boundary; ty++)
+        {
+            int tail_count;
+            const blob_run_t *tail = blob_labeler_row_runs(upper, ty, &tail_count);
+
+            for (int hy = boundary; hy <= ty + gap && hy < fp->bands[b + 1].y1; hy++)
+            {
+                int head_count;
+                const blob_run_t *head = blob_labeler_row_runs(lower, hy, &head_count);
+                int k = 0;
+
+                for (int t = 0; t < tail_count; t++)
+                {
+                    while (k < head_count && head[k].x1 < tail[t].x0 - gap)
+                        k++;
+                    for (int h = k; h < head_count && head[h].x0 <= tail[t].x1 + gap; h++)
+                    {
+                        if (blob_runs_touch(&tail[t], &head[h], gap))
+                            blob_label_union(merged, offsets[b] + tail[t].label, offsets[b + 1] + head[h].label);
+                    }
+                }
+            }
+        }
+    }
+    return true;
+}
+
+bool frame_parallel_process(frame_parallel_t *fp, const pixel_frame_t *frame, const class_lut_t *lut,
+                            uint8_t *class_map, frame_result_t *result)
+{
+    for (int b = 0; b < fp->band_count; b++)
+    {
+        fp->bands[b].frame = frame;
+        fp->bands[b].lut = lut;
+        fp->bands[b].class_map = class_map;
+    }
+
+    worker_pool_run(&fp->pool, band_job, fp->bands, sizeof(frame_band_t));
+
+    for (int b = 0; b < fp->band_count; b++)
+    {
+        if (!fp->bands[b].ok)
+            return false;
+    }
+    if (!stitch_bands(fp))
+        return false;
+
+    // band order then label order is raster order of first pixels
+    for (int l = 0; l < fp->merged_count; l++)
+    {
+        if (fp->merged[l].parent == l)
+            frame_result_add(result, &fp->merged[l]);
+    }
+    return true;
+}
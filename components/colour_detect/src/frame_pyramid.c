@@ -0,0 +1,313 @@
+#include <string.h>
+#include "detect_port.h"
+#include "frame_pyramid.h"
+
+static const char *TAG = "frame_pyramid";
+
+static void roi_retire(void *ctx, const blob_label_stats_t *stats);
+
+bool frame_pyramid_init(frame_pyramid_t *fp, int width, int height, int max_gap,
+                        int min_pixels, int factor, detect_arena_t *arena)
+{
+    memset(fp, 0, sizeof(*fp));
+    fp->arena = arena;
+    fp->width = width;
+    fp->height = height;
+    fp->max_gap = max_gap;
+    fp->min_pixels = min_pixels;
+    fp->factor = factor;
+    fp->pad = factor + max_gap;
+    fp->coarse_width = (width + factor - 1) / factor;
+    fp->coarse_height = (height + factor - 1) / factor;
+
+    // Half the samples a minimum-size solid blob would give, so blobs with
+    // holes still qualify; never 1 at 1/4 scale, so isolated noise samples
+    // do not each open a box
+    int cell = factor * factor;
+    fp->coarse_min = (min_pixels + 2 * cell - 1) / (2 * cell);
+    if (fp->coarse_min < 1)
+        fp->coarse_min = 1;
+
+    // Cells closer than max_gap pixels are at most this many cells apart
+    int coarse_gap = (max_gap + factor - 1) / factor;
+    if (coarse_gap < 1)
+        coarse_gap = 1;
+
+    fp->coarse_map = (uint8_t *)detect_arena_alloc(arena, (size_t)fp->coarse_width * fp->coarse_height,
+                                                   MALLOC_CAP_SPIRAM);
+    fp->class_row = (uint8_t *)detect_arena_alloc(arena, width, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    if (fp->coarse_map == NULL || fp->class_row == NULL ||
+        !blob_labeler_init_in(&fp->coarse_labeler, fp->coarse_width, fp->coarse_height, coarse_gap, arena) ||
+        !blob_labeler_init_in(&fp->roi_labeler, width, height, max_gap, arena) ||
+        !blob_labeler_set_retire(&fp->roi_labeler, roi_retire, NULL))
+    {
+        ESP_LOGE(TAG, "Failed to allocate pyramid state!");
+        frame_pyramid_free(fp);
+        return false;
+    }
+    return true;
+}
+
+void frame_pyramid_free(frame_pyramid_t *fp)
+{
+    detect_arena_free(fp->arena, fp->coarse_map);
+    detect_arena_free(fp->arena, fp->class_row);
+    blob_labeler_free(&fp->coarse_labeler);
+    blob_labeler_free(&fp->roi_labeler);
+    fp->coarse_map = NULL;
+    fp->class_row = NULL;
+}
+
+// True if a pixel of one box can be within max_gap of a pixel of the other
+static bool rois_near(const frame_roi_t *a, const frame_roi_t *b, int max_gap)
+{
+    return b->x0 - a->x1 <= max_gap && a->x0 - b->x1 <= max_gap &&
+           b->y0 - a->y1 <= max_gap && a->y0 - b->y1 <= max_gap;
+}
+
+// Adds a box and merges it with every box it could share a blob with, so
+// the final boxes are disjoint and no component spans two of them
+static bool add_roi(frame_pyramid_t *fp, frame_roi_t roi)
+{
+    for (int i = 0; i < fp->roi_count;)
+    {
+        frame_roi_t *other = &fp->rois[i];
+        if (!rois_near(&roi, other, fp->max_gap))
+        {
+            i++;
+            continue;
+        }
+        if (other->x0 < roi.x0)
+            roi.x0 = other->x0;
+        if (other->y0 < roi.y0)
+            roi.y0 = other->y0;
+        if (other->x1 > roi.x1)
+            roi.x1 = other->x1;
+        if (other->y1 > roi.y1)
+            roi.y1 = other->y1;
+        // the grown box may now reach boxes already checked, start over
+        fp->rois[i] = fp->rois[--fp->roi_count];
+        i = 0;
+    }
+    if (fp->roi_count == FRAME_PYRAMID_MAX_ROIS)
+        return false;
+    fp->rois[fp->roi_count++] = roi;
+    return true;
+}
+
+// Classifies one sample per cell, labels the coarse map and turns every
+// candidate component into a padded full-resolution box. Returns false when
+// the boxes are not worth it and the whole frame should be refined.
+static bool find_rois(frame_pyramid_t *fp, const pixel_frame_t *frame, const class_lut_t *lut)
+{
+    int f = fp->factor;
+    blob_labeler_t *lab = &fp->coarse_labeler;
+
+    blob_labeler_reset(lab, 0);
+    for (int cy = 0; cy < fp->coarse_height; cy++)
+    {
+        int y = cy * f + f / 2 < fp->height ? cy * f + f / 2 : fp->height - 1;
+        const uint8_t *row = pixel_frame_row(frame, y);
+        uint8_t *coarse_row = fp->coarse_map + (size_t)cy * fp->coarse_width;
+        for (int cx = 0; cx < fp->coarse_width; cx++)
+        {
+            int x = cx * f + f / 2 < fp->width ? cx * f + f / 2 : fp->width - 1;
+            coarse_row[cx] = class_lut_lookup_at(lut, row, x);
+        }
+        if (!blob_labeler_push_class_row(lab, coarse_row))
+            return false;
+    }
+
+    fp->roi_count = 0;
+    int cursor = 0;
+    const blob_label_stats_t *stats;
+    while ((stats = blob_labeler_next(lab, &cursor)) != NULL)
+    {
+        if (stats->pixel_count < fp->coarse_min)
+            continue;
+        frame_roi_t roi = {
+            .x0 = stats->min_x * f - fp->pad,
+            .y0 = stats->min_y * f - fp->pad,
+            .x1 = (stats->max_x + 1) * f - 1 + fp->pad,
+            .y1 = (stats->max_y + 1) * f - 1 + fp->pad,
+        };
+        roi.x0 = roi.x0 < 0 ? 0 : roi.x0;
+        roi.y0 = roi.y0 < 0 ? 0 : roi.y0;
+        roi.x1 = roi.x1 >= fp->width ? fp->width - 1 : roi.x1;
+        roi.y1 = roi.y1 >= fp->height ? fp->height - 1 : roi.y1;
+        if (!add_roi(fp, roi))
+            return false;
+    }
+
+    size_t area = 0;
+    for (int i = 0; i < fp->roi_count; i++)
+    {
+        area += (size_t)(fp->rois[i].x1 - fp->rois[i].x0 + 1) * (fp->rois[i].y1 - fp->rois[i].y0 + 1);
+    }
+    return area <= FRAME_PYRAMID_MAX_ROI_SHARE * fp->width * fp->height;
+}
+
+// Sides of a box that a kept blob comes within max_gap of, so it may go on
+// outside the box
+#define ROI_GROW_LEFT 1
+#define ROI_GROW_RIGHT 2
+#define ROI_GROW_TOP 4
+#define ROI_GROW_BOTTOM 8
+
+// Components of a box come out in box coordinates; shift them into the frame
+// so raster order and centres match the full-resolution labeler
+typedef struct
+{
+    frame_result_t *result;
+    const frame_pyramid_t *fp;
+    const frame_roi_t *roi;
+    int grow;
+} roi_ctx_t;
+
+static void roi_retire(void *ctx, const blob_label_stats_t *stats)
+{
+    roi_ctx_t *roi_ctx = (roi_ctx_t *)ctx;
+    const frame_pyramid_t *fp = roi_ctx->fp;
+    const frame_roi_t *roi = roi_ctx->roi;
+    int roi_width = roi->x1 - roi->x0 + 1;
+    blob_label_stats_t shifted = *stats;
+    int y = stats->first / roi_width;
+    int x = stats->first % roi_width;
+
+    shifted.first = y * fp->width + x + roi->x0;
+    shifted.sum_x += (int64_t)roi->x0 * stats->pixel_count;
+    shifted.min_x += roi->x0;
+    shifted.max_x += roi->x0;
+    frame_result_add(roi_ctx->result, &shifted);
+
+    if (stats->pixel_count < fp->min_pixels)
+        return;
+    if (roi->x0 > 0 && shifted.min_x - roi->x0 < fp->max_gap)
+        roi_ctx->grow |= ROI_GROW_LEFT;
+    if (roi->x1 < fp->width - 1 && roi->x1 - shifted.max_x < fp->max_gap)
+        roi_ctx->grow |= ROI_GROW_RIGHT;
+    if (roi->y0 > 0 && shifted.min_y - roi->y0 < fp->max_gap)
+        roi_ctx->grow |= ROI_GROW_TOP;
+    if (roi->y1 < fp->height - 1 && roi->y1 - shifted.max_y < fp->max_gap)
+        roi_ctx->grow |= ROI_GROW_BOTTOM;
+}
+
+// Returns the ROI_GROW_* sides the box has to grow on, or -1 when out of memory
+static int refine_roi(frame_pyramid_t *fp, const frame_roi_t *roi, const pixel_frame_t *frame,
+                      const class_lut_t *lut, frame_result_t *result)
+{
+    int roi_width = roi->x1 - roi->x0 + 1;
+    roi_ctx_t ctx = {
+        .result = result,
+        .fp = fp,
+        .roi = roi,
+    };
+    blob_labeler_t *labeler = &fp->roi_labeler;
+
+    // rows keep their frame index, so only x needs shifting afterwards
+    blob_labeler_set_retire(labeler, roi_retire, &ctx);
+    blob_labeler_set_width(labeler, roi_width);
+    blob_labeler_reset(labeler, roi->y0);
+
+    bool ok = true;
+    for (int y = roi->y0; y <= roi->y1 && ok; y++)
+    {
+        class_lut_classify_ids(lut, pixel_frame_row(frame, y), roi->x0, roi_width, fp->class_row);
+        ok = blob_labeler_push_class_row(labeler, fp->class_row);
+    }
+    if (ok)
+        blob_labeler_flush(labeler);
+    fp->refined_pixels += roi_width * (roi->y1 - roi->y0 + 1);
+    return ok ? ctx.grow : -1;
+}
+
+// Refines every box; a box whose blob may reach past it is grown by pad on
+// those sides and the refinement starts over, so no kept blob is cut off
+static bool refine_rois(frame_pyramid_t *fp, const pixel_frame_t *frame, const class_lut_t *lut,
+                        frame_result_t *result)
+{
+    for (int attempt = 0; attempt <= FRAME_PYRAMID_MAX_GROWS; attempt++)
+    {
+        int grown = 0;
+        frame_result_reset(result, lut->class_count, fp->min_pixels);
+        fp->refined_pixels = 0;
+        for (int i = 0; i < fp->roi_count; i++)
+        {
+            frame_roi_t roi = fp->rois[i];
+            int grow = refine_roi(fp, &roi, frame, lut, result);
+            if (grow < 0)
+                return false;
+            if (grow == 0)
+                continue;
+
+            if (grow & ROI_GROW_LEFT)
+                roi.x0 = roi.x0 - fp->pad < 0 ? 0 : roi.x0 - fp->pad;
+            if (grow & ROI_GROW_RIGHT)
+                roi.x1 = roi.x1 + fp->pad >= fp->width ? fp->width - 1 : roi.x1 + fp->pad;
+            if (grow & ROI_GROW_TOP)
+                roi.y0 = roi.y0 - fp->pad < 0 ? 0 : roi.y0 - fp->pad;
+            if (grow & ROI_GROW_BOTTOM)
+                roi.y1 = roi.y1 + fp->pad >= fp->height ? fp->height - 1 : roi.y1 + fp->pad;
+            fp->rois[i] = fp->rois[--fp->roi_count];
+            if (!add_roi(fp, roi))
+                return false;
+            grown++;
+            i--; // the slot now holds another box
+        }
+        if (grown == 0)
+            return true;
+    }
+    return false;
+}
+
+// Class pixels outside every box, estimated from the samples: each sample
+// stands for its whole cell
+static void add_unrefined_pixels(const frame_pyramid_t *fp, frame_result_t *result)
+{
+    int f = fp->factor;
+    for (int cy = 0; cy < fp->coarse_height; cy++)
+    {
+        int y = cy * f + f / 2 < fp->height ? cy * f + f / 2 : fp->height - 1;
+        int cell_h = fp->height - cy * f < f ? fp->height - cy * f : f;
+        const uint8_t *coarse_row = fp->coarse_map + (size_t)cy * fp->coarse_width;
+        for (int cx = 0; cx < fp->coarse_width; cx++)
+        {
+            if (coarse_row[cx] == CLASS_NONE)
+                continue;
+            int x = cx * f + f / 2 < fp->width ? cx * f + f / 2 : fp->width - 1;
+            bool refined = false;
+            for (int i = 0; i < fp->roi_count && !refined; i++)
+            {
+                const frame_roi_t *roi = &fp->rois[i];
+                refined = x >= roi->x0 && x <= roi->x1 && y >= roi->y0 && y <= roi->y1;
+            }
+            if (!refined)
+            {
+                int cell_w = fp->width - cx * f < f ? fp->width - cx * f : f;
+                result->classes[coarse_row[cx] - 1].pixel_count += cell_w * cell_h;
+            }
+        }
+    }
+}
+
+bool frame_pyramid_process(frame_pyramid_t *fp, const pixel_frame_t *frame, const class_lut_t *lut,
+                           frame_result_t *result)
+{
+    fp->full_frame = !find_rois(fp, frame, lut) || !refine_rois(fp, frame, lut, result);
+    if (fp->full_frame)
+    {
+        // a single box over the whole frame never needs to grow
+        frame_roi_t whole = {0, 0, fp->width - 1, fp->height - 1};
+        fp->roi_count = 0;
+        frame_result_reset(result, lut->class_count, fp->min_pixels);
+        fp->refined_pixels = 0;
+        if (refine_roi(fp, &whole, frame, lut, result) < 0)
+        {
+            ESP_LOGE(TAG, "Full-frame refinement ran out of memory!");
+            return false;
+        }
+        return true;
+    }
+    add_unrefined_pixels(fp, result);
+    return true;
+}
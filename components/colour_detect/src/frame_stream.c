@@ -0,0 +1,56 @@
+#include <string.h>
+#include "detect_port.h"
+#include "frame_stream.h"
+
+static const char *TAG = "frame_stream";
+
+bool frame_stream_init(frame_stream_t *fs, int width, int height, int max_gap,
+                       int min_pixels, const class_lut_t *lut, detect_arena_t *arena)
+{
+    memset(fs, 0, sizeof(*fs));
+    fs->arena = arena;
+    fs->width = width;
+    fs->height = height;
+    fs->lut = lut;
+    frame_result_reset(&fs->result, lut->class_count, min_pixels);
+
+    fs->class_row = (uint8_t *)detect_arena_alloc(arena, width, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    if (fs->class_row == NULL ||
+        !blob_labeler_init_in(&fs->labeler, width, height, max_gap, arena) ||
+        !blob_labeler_set_retire(&fs->labeler, frame_result_add, &fs->result))
+    {
+        ESP_LOGE(TAG, "Failed to set up stream state");
+        frame_stream_free(fs);
+        return false;
+    }
+    frame_stream_begin(fs);
+    return true;
+}
+
+void frame_stream_free(frame_stream_t *fs)
+{
+    detect_arena_free(fs->arena, fs->class_row);
+    fs->class_row = NULL;
+    blob_labeler_free(&fs->labeler);
+}
+
+void frame_stream_begin(frame_stream_t *fs)
+{
+    fs->y = 0;
+    frame_result_reset(&fs->result, fs->lut->class_count, fs->result.min_pixels);
+    blob_labeler_reset(&fs->labeler, 0);
+}
+
+bool frame_stream_push_rows(frame_stream_t *fs, const uint8_t *rows, int stride, int row_count)
+{
+    for (int r = 0; r < row_count && fs->y < fs->height; r++, fs->y++)
+    {
+        class_lut_classify_ids(fs->lut, rows + (size_t)r * stride, 0, fs->width, fs->class_row);
+        if (!blob_labeler_push_class_row(&fs->labeler, fs->class_row))
+            return false;
+    }
+
+    if (fs->y == fs->height)
+        blob_labeler_flush(&fs->labeler);
+    return true;
+}
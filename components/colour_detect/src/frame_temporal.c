@@ -0,0 +1,205 @@
+#include <string.h>
+#include "detect_port.h"
+#include "frame_temporal.h"
+
+static const char *TAG = "frame_temporal";
+
+// Runs every row starts with, carved from one block; busier rows move to a
+// block of their own once and keep it
+#define ROW_INITIAL_RUNS 8
+
+bool frame_temporal_init(frame_temporal_t *ft, int width, int height, int max_gap, int min_pixels,
+                         const frame_temporal_config_t *config, detect_arena_t *arena)
+{
+    memset(ft, 0, sizeof(*ft));
+    ft->arena = arena;
+    ft->width = width;
+    ft->height = height;
+    ft->config = *config;
+    ft->tiles_x = (width + config->tile_size - 1) / config->tile_size;
+    ft->tiles_y = (height + config->tile_size - 1) / config->tile_size;
+    frame_result_reset(&ft->result, 0, min_pixels);
+
+    // Frame-sized state is only touched where tiles change, PSRAM is fine
+    size_t pixel_count = (size_t)width * height;
+    ft->reference = (uint16_t *)detect_arena_alloc(arena, pixel_count * sizeof(uint16_t), MALLOC_CAP_SPIRAM);
+    ft->class_map = (uint8_t *)detect_arena_alloc(arena, pixel_count, MALLOC_CAP_SPIRAM);
+    ft->rows = (temporal_row_t *)detect_arena_calloc(arena, height, sizeof(temporal_row_t), MALLOC_CAP_SPIRAM);
+    ft->run_block = (blob_run_t *)detect_arena_alloc(arena, (size_t)height * ROW_INITIAL_RUNS * sizeof(blob_run_t),
+                                                     MALLOC_CAP_SPIRAM);
+    ft->dirty_rows = (uint8_t *)detect_arena_alloc(arena, height, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    if (ft->rows != NULL && ft->run_block != NULL)
+    {
+        for (int y = 0; y < height; y++)
+        {
+            ft->rows[y].runs = ft->run_block + (size_t)y * ROW_INITIAL_RUNS;
+            ft->rows[y].capacity = ROW_INITIAL_RUNS;
+        }
+    }
+    if (ft->reference == NULL || ft->class_map == NULL || ft->rows == NULL || ft->run_block == NULL ||
+        ft->dirty_rows == NULL || !blob_labeler_init_in(&ft->labeler, width, height, max_gap, arena) ||
+        !blob_labeler_set_retire(&ft->labeler, frame_result_add, &ft->result))
+    {
+        ESP_LOGE(TAG, "Failed to allocate temporal state!");
+        frame_temporal_free(ft);
+        return false;
+    }
+    return true;
+}
+
+void frame_temporal_free(frame_temporal_t *ft)
+{
+    if (ft->rows != NULL)
+    {
+        for (int y = 0; y < ft->height; y++)
+        {
+            if (ft->rows[y].capacity > ROW_INITIAL_RUNS)
+                detect_arena_free(ft->arena, ft->rows[y].runs);
+        }
+    }
+    detect_arena_free(ft->arena, ft->reference);
+    detect_arena_free(ft->arena, ft->class_map);
+    detect_arena_free(ft->arena, ft->rows);
+    detect_arena_free(ft->arena, ft->run_block);
+    detect_arena_free(ft->arena, ft->dirty_rows);
+    blob_labeler_free(&ft->labeler);
+    ft->reference = NULL;
+    ft->class_map = NULL;
+    ft->rows = NULL;
+    ft->run_block = NULL;
+    ft->dirty_rows = NULL;
+}
+
+void frame_temporal_invalidate(frame_temporal_t *ft)
+{
+    ft->primed = false;
+}
+
+static inline int pixel_moved(uint16_t a, uint16_t b, int tolerance)
+{
+    int dr = (a >> 11) - (b >> 11);
+    int dg = ((a >> 5) & 0x3F) - ((b >> 5) & 0x3F);
+    int db = (a & 0x1F) - (b & 0x1F);
+    return (dr > tolerance) | (dr < -tolerance) | (dg > tolerance) | (dg < -tolerance) |
+           (db > tolerance) | (db < -tolerance);
+}
+
+// True once more than tile_threshold pixels of the tile moved by more than
+// pixel_tolerance in any channel since the tile was last classified. Rows
+// that did not change at all cost a memcmp; the per-pixel count is branch
+// free so the compiler can vectorise it.
+static bool tile_changed(const frame_temporal_t *ft, const uint16_t *pixels,
+                         int x0, int y0, int x1, int y1)
+{
+    int tolerance = ft->config.pixel_tolerance;
+    int changed = 0;
+    for (int y = y0; y < y1; y++)
+    {
+        const uint16_t *cur = pixels + (size_t)y * ft->width;
+        const uint16_t *ref = ft->reference + (size_t)y * ft->width;
+        if (memcmp(cur + x0, ref + x0, (x1 - x0) * sizeof(uint16_t)) == 0)
+            continue;
+        for (int x = x0; x < x1; x++)
+        {
+            changed += pixel_moved(cur[x], ref[x], tolerance);
+        }
+        if (changed > ft->config.tile_threshold)
+            return true;
+    }
+    return false;
+}
+
+static void classify_tile(frame_temporal_t *ft, const uint16_t *pixels, const class_lut_t *lut,
+                          int x0, int y0, int x1, int y1)
+{
+    for (int y = y0; y < y1; y++)
+    {
+        size_t offset = (size_t)y * ft->width + x0;
+        memcpy(ft->reference + offset, pixels + offset, (x1 - x0) * sizeof(uint16_t));
+        class_lut_classify_ids(lut, (const uint8_t *)(pixels + (size_t)y * ft->width), x0, x1 - x0,
+                               ft->class_map + offset);
+        ft->dirty_rows[y] = 1;
+    }
+}
+
+static bool update_row_runs(frame_temporal_t *ft, int y)
+{
+    temporal_row_t *row = &ft->rows[y];
+    const uint8_t *class_row = ft->class_map + (size_t)y * ft->width;
+    int count = blob_count_class_runs(class_row, ft->width);
+    if (count > row->capacity)
+    {
+        // double, so a row that keeps gaining runs settles quickly; the old
+        // runs are extracted again, nothing to copy
+        int capacity = count > 2 * row->capacity ? count : 2 * row->capacity;
+        blob_run_t *runs = (blob_run_t *)detect_arena_alloc(ft->arena, capacity * sizeof(blob_run_t),
+                                                            MALLOC_CAP_SPIRAM);
+        if (runs == NULL)
+        {
+            ESP_LOGE(TAG, "Failed to grow runs of row %d!", y);
+            return false;
+        }
+        if (row->capacity > ROW_INITIAL_RUNS)
+            detect_arena_free(ft->arena, row->runs);
+        row->runs = runs;
+        row->capacity = capacity;
+    }
+    row->count = blob_extract_class_runs(class_row, ft->width, row->runs);
+    return true;
+}
+
+bool frame_temporal_process(frame_temporal_t *ft, const uint16_t *pixels, const class_lut_t *lut)
+{
+    int size = ft->config.tile_size;
+    if (lut->format != PIXEL_FORMAT_RGB565)
+    {
+        ESP_LOGE(TAG, "Temporal mode needs an RGB565 class table, got %s!", pixel_format_name(lut->format));
+        return false;
+    }
+
+    memset(ft->dirty_rows, 0, ft->height);
+    ft->dirty_tiles = 0;
+    for (int ty = 0; ty < ft->tiles_y; ty++)
+    {
+        int y0 = ty * size;
+        int y1 = y0 + size < ft->height ? y0 + size : ft->height;
+        for (int tx = 0; tx < ft->tiles_x; tx++)
+        {
+            int x0 = tx * size;
+            int x1 = x0 + size < ft->width ? x0 + size : ft->width;
+            if (ft->primed && !tile_changed(ft, pixels, x0, y0, x1, y1))
+                continue;
+            classify_tile(ft, pixels, lut, x0, y0, x1, y1);
+            ft->dirty_tiles++;
+        }
+    }
+
+    ft->relabeled = !ft->primed || ft->dirty_tiles > 0;
+    ft->primed = true;
+    if (!ft->relabeled)
+        return true;
+
+    for (int y = 0; y < ft->height; y++)
+    {
+        if (ft->dirty_rows[y] && !update_row_runs(ft, y))
+        {
+            ft->primed = false;
+            return false;
+        }
+    }
+
+    // Every row is labeled again, but from its cached runs
+    frame_result_reset(&ft->result, lut->class_count, ft->result.min_pixels);
+    blob_labeler_reset(&ft->labeler, 0);
+    for (int y = 0; y < ft->height; y++)
+    {
+        if (!blob_labeler_push_runs(&ft->labeler, ft->rows[y].runs, ft->rows[y].count))
+        {
+            ESP_LOGE(TAG, "Blob labeling ran out of memory at row %d!", y);
+            ft->primed = false;
+            return false;
+        }
+    }
+    blob_labeler_flush(&ft->labeler);
+    return true;
+}
@@ -0,0 +1,79 @@
+#include "hsv.h"
+
+// HSV conversion function
+hsv_t rgb565_to_hsv(uint16_t rgb565)
+{
+    hsv_t hsv;
+
+    // Extract RGB components (5-bit R, 6-bit G, 5-bit B)
+    uint8_t r = (rgb565 >> 11) & 0x1F;
+    uint8_t g = (rgb565 >> 5) & 0x3F;
+    uint8_t b = rgb565 & 0x1F;
+
+    // Scale to 8-bit
+    r = (r * 255) / 31;
+    g = (g * 255) / 63;
+    b = (b * 255) / 31;
+
+    // Find min and max
+    uint8_t min = r;
+    uint8_t max = r;
+    if (g < min)
+        min = g;
+    if (b < min)
+        min = b;
+    if (g > max)
+        max = g;
+    if (b > max)
+        max = b;
+
+    uint8_t delta = max - min;
+
+    // Value
+    hsv.v = max;
+
+    // Saturation
+    if (max == 0)
+    {
+        hsv.s = 0;
+    }
+    else
+    {
+        hsv.s = (delta * 255) / max;
+    }
+
+    // Hue
+    if (delta == 0)
+    {
+        hsv.h = 0;
+    }
+    else
+    {
+        int hue_temp;
+        if (max == r)
+        {
+            hue_temp = 30 * ((g - b) / delta);
+            if (g < b)
+                hue_temp += 180;
+        }
+        else if (max == g)
+        {
+            hue_temp = 30 * (2 + ((b - r) / delta));
+        }
+        else
+        {
+            hue_temp = 30 * (4 + ((r - g) / delta));
+        }
+        hsv.h = (hue_temp * 180) / 360;
+    }
+
+    return hsv;
+}
+
+// Threshold checking function
+bool matches_threshold(hsv_t hsv, color_threshold_t thresh)
+{
+    return (hsv.h >= thresh.h_min && hsv.h <= thresh.h_max &&
+            hsv.s >= thresh.s_min && hsv.s <= thresh.s_max &&
+            hsv.v >= thresh.v_min && hsv.v <= thresh.v_max);
+}
@@ -0,0 +1,81 @@
+#include <string.h>
+#include "detect_port.h"
+#include "pixel_format.h"
+
+static const char *TAG = "pixel_format";
+
+static const char *const format_names[PIXEL_FORMAT_COUNT] = {"rgb565", "rgb565be", "rgb888", "yuv422"};
+
+int pixel_format_bytes(pixel_format_t format)
+{
+    return format == PIXEL_FORMAT_RGB888 ? 3 : 2;
+}
+
+const char *pixel_format_name(pixel_format_t format)
+{
+    return format < PIXEL_FORMAT_COUNT ? format_names[format] : "?";
+}
+
+bool pixel_format_parse(const char *name, pixel_format_t *format)
+{
+    for (int f = 0; f < PIXEL_FORMAT_COUNT; f++)
+    {
+        if (strcmp(name, format_names[f]) == 0)
+        {
+            *format = (pixel_format_t)f;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool pixel_frame_wrap(pixel_frame_t *frame, const void *data, pixel_format_t format, int width, int height,
+                      int stride)
+{
+    int row_bytes = width * pixel_format_bytes(format);
+    if (stride == 0)
+        stride = row_bytes;
+    if (stride < row_bytes || (format != PIXEL_FORMAT_RGB888 && stride % 2 != 0) ||
+        (format == PIXEL_FORMAT_YUV422 && width % 2 != 0))
+    {
+        ESP_LOGE(TAG, "Unusable %s frame: %dx%d, stride %d bytes!", pixel_format_name(format), width, height,
+                 stride);
+        return false;
+    }
+    frame->data = (const uint8_t *)data;
+    frame->format = format;
+    frame->width = width;
+    frame->height = height;
+    frame->stride = stride;
+    return true;
+}
+
+static uint8_t clamp_byte(int v)
+{
+    return v < 0 ? 0 : v > 255 ? 255 : (uint8_t)v;
+}
+
+// BT.601 full range (JFIF), what the camera sensors' YUV output uses, in
+// 16.16 fixed point
+static uint16_t yuv_to_rgb565(int y, int u, int v)
+{
+    u -= 128;
+    v -= 128;
+    uint8_t r = clamp_byte(y + ((91881 * v + 32768) >> 16));
+    uint8_t g = clamp_byte(y - ((22554 * u + 46802 * v + 32768) >> 16));
+    uint8_t b = clamp_byte(y + ((116130 * u + 32768) >> 16));
+    return (uint16_t)((r >> 3) << 11 | (g >> 2) << 5 | b >> 3);
+}
+
+uint16_t pixel_format_index_colour(pixel_format_t format, uint16_t index)
+{
+    switch (format)
+    {
+    case PIXEL_FORMAT_RGB565_BE:
+        return (uint16_t)(index << 8 | index >> 8);
+    case PIXEL_FORMAT_YUV422:
+        return yuv_to_rgb565((index >> 10) << 2 | 2, ((index >> 5) & 0x1F) << 3 | 4, (index & 0x1F) << 3 | 4);
+    default:
+        return index;
+    }
+}
@@ -0,0 +1,79 @@
+#include <string.h>
+#include "detect_port.h"
+#include "pixel_mask.h"
+
+static const char *TAG = "pixel_mask";
+
+bool pixel_mask_init(pixel_mask_t *mask, int width, int height, uint32_t caps)
+{
+    return pixel_mask_init_in(mask, width, height, caps, NULL);
+}
+
+bool pixel_mask_init_in(pixel_mask_t *mask, int width, int height, uint32_t caps, detect_arena_t *arena)
+{
+    mask->width = width;
+    mask->height = height;
+    mask->arena = arena;
+    mask->words_per_row = (width + PIXEL_MASK_WORD_BITS - 1) / PIXEL_MASK_WORD_BITS;
+    mask->words = (uint32_t *)detect_arena_alloc(arena, (size_t)mask->words_per_row * height * sizeof(uint32_t),
+                                                 caps);
+    if (mask->words == NULL)
+    {
+        ESP_LOGE(TAG, "Failed to allocate %dx%d mask!", width, height);
+        return false;
+    }
+    pixel_mask_clear(mask);
+    return true;
+}
+
+void pixel_mask_free(pixel_mask_t *mask)
+{
+    detect_arena_free(mask->arena, mask->words);
+    mask->words = NULL;
+}
+
+void pixel_mask_clear(pixel_mask_t *mask)
+{
+    memset(mask->words, 0, (size_t)mask->words_per_row * mask->height * sizeof(uint32_t));
+}
+
+int pixel_mask_row_popcount(const pixel_mask_t *mask, int y)
+{
+    const uint32_t *row = pixel_mask_row(mask, y);
+    int count = 0;
+    for (int w = 0; w < mask->words_per_row; w++)
+    {
+        count += __builtin_popcount(row[w]);
+    }
+    return count;
+}
+
+size_t pixel_mask_popcount(const pixel_mask_t *mask)
+{
+    size_t count = 0;
+    size_t total_words = (size_t)mask->words_per_row * mask->height;
+    for (size_t w = 0; w < total_words; w++)
+    {
+        count += __builtin_popcount(mask->words[w]);
+    }
+    return count;
+}
+
+int pixel_mask_row_next(const pixel_mask_t *mask, int y, int x)
+{
+    if (x >= mask->width)
+        return -1;
+
+    const uint32_t *row = pixel_mask_row(mask, y);
+    int w = x / PIXEL_MASK_WORD_BITS;
+    // drop the bits below x in the first word
+    uint32_t bits = row[w] & (~0u << (x % PIXEL_MASK_WORD_BITS));
+
+    while (bits == 0)
+    {
+        if (++w >= mask->words_per_row)
+            return -1;
+        bits = row[w];
+    }
+    return w * PIXEL_MASK_WORD_BITS + __builtin_ctz(bits);
+}
@@ -0,0 +1,138 @@
+#include <string.h>
+#include "pixel_morph.h"
+
+static int clamp_reach(int reach)
+{
+    return reach < 0 ? 0 : reach > PIXEL_MORPH_MAX_REACH ? PIXEL_MORPH_MAX_REACH : reach;
+}
+
+pixel_morph_box_t pixel_morph_gap_box(int max_gap)
+{
+    // boxes of side max_gap touch when their centres are max_gap apart
+    int side = max_gap < 1 ? 1 : max_gap;
+    int before = clamp_reach((side - 1) / 2);
+    int after = clamp_reach(side - 1 - before);
+    pixel_morph_box_t box = {before, after, before, after};
+    return box;
+}
+
+// Valid bits of the last word of a row
+static uint32_t last_word_mask(int width)
+{
+    int bits = width % PIXEL_MASK_WORD_BITS;
+    return bits == 0 ? ~0u : (1u << bits) - 1;
+}
+
+// Vertical pass: each dst row is the OR (AND) of the src rows within reach
+static void column_pass(const pixel_mask_t *src, pixel_mask_t *dst, int up, int down, bool erode)
+{
+    int words = src->words_per_row;
+    for (int y = 0; y < src->height; y++)
+    {
+        // a src pixel on row r covers dst rows r - up .. r + down
+        int r0 = y - down < 0 ? 0 : y - down;
+        int r1 = y + up >= src->height ? src->height - 1 : y + up;
+        uint32_t *out = pixel_mask_row(dst, y);
+        memcpy(out, pixel_mask_row(src, r0), words * sizeof(uint32_t));
+        for (int r = r0 + 1; r <= r1; r++)
+        {
+            const uint32_t *in = pixel_mask_row(src, r);
+            if (erode)
+            {
+                for (int w = 0; w < words; w++)
+                    out[w] &= in[w];
+            }
+            else
+            {
+                for (int w = 0; w < words; w++)
+                    out[w] |= in[w];
+            }
+        }
+    }
+}
+
+// Horizontal pass over one row in place. Shifted copies take their carry
+// bits from the untouched neighbour words; for erosion everything past the
+// row ends reads as set.
+static void row_pass(uint32_t *row, int words, uint32_t last_mask, int left, int right, bool erode)
+{
+    uint32_t fill = erode ? ~0u : 0;
+    uint32_t prev = fill;
+    uint32_t cur = row[0] | (erode && words == 1 ? ~last_mask : 0);
+
+    for (int w = 0; w < words; w++)
+    {
+        uint32_t next = w + 1 < words ? row[w + 1] : fill;
+        if (erode && w + 1 == words - 1)
+            next |= ~last_mask;
+
+        uint32_t out = cur;
+        // pixel x - k moves to x for the right reach, x + k for the left
+        for (int k = 1; k <= right; k++)
+        {
+            uint32_t shifted = cur << k | prev >> (PIXEL_MASK_WORD_BITS - k);
+            out = erode ? out & shifted : out | shifted;
+        }
+        for (int k = 1; k <= left; k++)
+        {
+            uint32_t shifted = cur >> k | next << (PIXEL_MASK_WORD_BITS - k);
+            out = erode ? out & shifted : out | shifted;
+        }
+        row[w] = out;
+        prev = cur;
+        cur = next;
+    }
+    // padding bits stay zero
+    row[words - 1] &= last_mask;
+}
+
+static void box_pass(const pixel_mask_t *src, pixel_mask_t *dst, pixel_morph_box_t box, bool erode)
+{
+    int left = clamp_reach(box.left);
+    int right = clamp_reach(box.right);
+    uint32_t last_mask = last_word_mask(src->width);
+
+    column_pass(src, dst, clamp_reach(box.up), clamp_reach(box.down), erode);
+    if (left == 0 && right == 0)
+        return;
+    for (int y = 0; y < dst->height; y++)
+    {
+        row_pass(pixel_mask_row(dst, y), dst->words_per_row, last_mask, left, right, erode);
+    }
+}
+
+void pixel_morph_dilate_box(const pixel_mask_t *src, pixel_mask_t *dst, pixel_morph_box_t box)
+{
+    box_pass(src, dst, box, false);
+}
+
+void pixel_morph_erode_box(const pixel_mask_t *src, pixel_mask_t *dst, pixel_morph_box_t box)
+{
+    // a pixel stays if its whole box is set, i.e. the passes run over the mirrored box
+    pixel_morph_box_t mirrored = {box.right, box.left, box.down, box.up};
+    box_pass(src, dst, mirrored, true);
+}
+
+void pixel_morph_dilate(const pixel_mask_t *src, pixel_mask_t *dst, int radius)
+{
+    pixel_morph_box_t box = {radius, radius, radius, radius};
+    box_pass(src, dst, box, false);
+}
+
+void pixel_morph_erode(const pixel_mask_t *src, pixel_mask_t *dst, int radius)
+{
+    pixel_morph_box_t box = {radius, radius, radius, radius};
+    box_pass(src, dst, box, true);
+}
+
+void pixel_morph_open(pixel_mask_t *mask, pixel_mask_t *tmp, int radius)
+{
+    pixel_morph_erode(mask, tmp, radius);
+    pixel_morph_dilate(tmp, mask, radius);
+}
+
+void pixel_morph_close(pixel_mask_t *mask, pixel_mask_t *tmp, int radius)
+{
+    pixel_morph_dilate(mask, tmp, radius);
+    pixel_morph_erode(tmp, mask, radius);
+}
@@ -0,0 +1,350 @@
+#include <string.h>
+#include "detect_port.h"
+#include "tiled_image.h"
+
+#ifdef ESP_PLATFORM
+#include "esp_partition.h"
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+static const char *TAG = "tiled_image";
+
+_Static_assert(sizeof(tiled_image_header_t) == 40, "tiled image header layout");
+_Static_assert(sizeof(tiled_image_entry_t) == 12, "tiled image entry layout");
+
+#ifdef ESP_PLATFORM
+bool tiled_pack_map(tiled_pack_t *pack, const char *name)
+{
+    memset(pack, 0, sizeof(*pack));
+    const esp_partition_t *part = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, name);
+    if (part == NULL)
+    {
+        ESP_LOGE(TAG, "No data partition %s!", name);
+        return false;
+    }
+
+    const void *data;
+    esp_partition_mmap_handle_t handle;
+    esp_err_t err = esp_partition_mmap(part, 0, part->size, ESP_PARTITION_MMAP_DATA, &data, &handle);
+    if (err != ESP_OK)
+    {
+        ESP_LOGE(TAG, "Failed to map partition %s: %s!", name, esp_err_to_name(err));
+        return false;
+    }
+    pack->data = (const uint8_t *)data;
+    pack->size = part->size;
+    pack->handle = handle;
+    return true;
+}
+
+void tiled_pack_unmap(tiled_pack_t *pack)
+{
+    if (pack->data != NULL)
+        esp_partition_munmap(pack->handle);
+    pack->data = NULL;
+}
+#else
+bool tiled_pack_map(tiled_pack_t *pack, const char *name)
+{
+    memset(pack, 0, sizeof(*pack));
+    int fd = open(name, O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0 || st.st_size == 0)
+    {
+        ESP_LOGE(TAG, "Cannot open %s!", name);
+        if (fd >= 0)
+            close(fd);
+        return false;
+    }
+
+    void *data = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED)
+    {
+        ESP_LOGE(TAG, "Failed to map %s!", name);
+        return false;
+    }
+    pack->data = (const uint8_t *)data;
+    pack->size = (size_t)st.st_size;
+    return true;
+}
+
+void tiled_pack_unmap(tiled_pack_t *pack)
+{
+    if (pack->data != NULL)
+        munmap((void *)pack->data, pack->size);
+    pack->data = NULL;
+}
+#endif
+
+bool tiled_pack_next(const tiled_pack_t *pack, size_t *offset, tiled_image_t *image)
+{
+    // the rest of a partition is erased flash, all 0xFF
+    if (*offset + sizeof(tiled_image_header_t) > pack->size ||
+        memcmp(pack->data + *offset, TILED_IMAGE_MAGIC, 4) != 0)
+        return false;
+    if (!tiled_image_open(image, pack->data + *offset, pack->size - *offset))
+        return false;
+    size_t next = *offset + image->header->total_size;
+    *offset = (next + TILED_IMAGE_ALIGN - 1) / TILED_IMAGE_ALIGN * TILED_IMAGE_ALIGN;
+    return true;
+}
+
+static int unit_pixels(pixel_format_t format)
+{
+    return format == PIXEL_FORMAT_YUV422 ? 2 : 1;
+}
+
+void tiled_image_tile_rect(const tiled_image_t *image, int t, int *x0, int *y0, int *width, int *height)
+{
+    int tile_width = image->header->tile_width;
+    int tile_height = image->header->tile_height;
+    *x0 = t % image->tiles_x * tile_width;
+    *y0 = t / image->tiles_x * tile_height;
+    *width = image->width - *x0 < tile_width ? image->width - *x0 : tile_width;
+    *height = image->height - *y0 < tile_height ? image->height - *y0 : tile_height;
+}
+
+// Checks that a tile's data matches its encoding, down to the run lengths
+static bool tile_valid(const tiled_image_t *image, int t)
+{
+    const tiled_image_entry_t *entry = &image->tiles[t];
+    int x0, y0, width, height;
+    tiled_image_tile_rect(image, t, &x0, &y0, &width, &height);
+    int unit_bytes = unit_pixels(image->format) * pixel_format_bytes(image->format);
+    uint32_t units = (uint32_t)(width * height / unit_pixels(image->format));
+
+    if (entry->offset % TILED_IMAGE_ALIGN != 0 || entry->offset > image->header->total_size ||
+        entry->size > image->header->total_size - entry->offset)
+        return false;
+    switch (entry->encoding)
+    {
+    case TILED_TILE_RAW:
+        return entry->size == units * unit_bytes;
+    case TILED_TILE_UNIFORM:
+        return entry->size == (uint32_t)unit_bytes;
+    case TILED_TILE_RLE:
+    {
+        int record = 2 + unit_bytes;
+        if (entry->size % record != 0)
+            return false;
+        const uint8_t *p = image->base + entry->offset;
+        uint32_t total = 0;
+        for (uint32_t i = 0; i < entry->size; i += record)
+            total += p[i] | p[i + 1] << 8;
+        return total == units;
+    }
+    default:
+        return false;
+    }
+}
+
+bool tiled_image_open(tiled_image_t *image, const void *data, size_t size)
+{
+    memset(image, 0, sizeof(*image));
+    const tiled_image_header_t *h = (const tiled_image_header_t *)data;
+    if (size < sizeof(*h) || ((uintptr_t)data & 3) != 0 || memcmp(h->magic, TILED_IMAGE_MAGIC, 4) != 0 ||
+        h->version != TILED_IMAGE_VERSION || h->format >= PIXEL_FORMAT_COUNT || h->total_size > size)
+    {
+        ESP_LOGE(TAG, "Not a version %d tiled image!", TILED_IMAGE_VERSION);
+        return false;
+    }
+
+    image->base = (const uint8_t *)data;
+    image->header = h;
+    image->format = (pixel_format_t)h->format;
+    image->width = h->width;
+    image->height = h->height;
+    image->tiles_x = h->tile_width > 0 ? (h->width + h->tile_width - 1) / h->tile_width : 0;
+    image->tiles_y = h->tile_height > 0 ? (h->height + h->tile_height - 1) / h->tile_height : 0;
+    image->tiles = (const tiled_image_entry_t *)(image->base + sizeof(*h));
+
+    bool yuv = image->format == PIXEL_FORMAT_YUV422;
+    if (image->tiles_x == 0 || image->tiles_y == 0 || (yuv && (h->width % 2 != 0 || h->tile_width % 2 != 0)) ||
+        h->tile_count != (uint32_t)(image->tiles_x * image->tiles_y) ||
+        sizeof(*h) + (size_t)h->tile_count * sizeof(tiled_image_entry_t) > h->total_size)
+    {
+        ESP_LOGE(TAG, "Tiled image %.*s: unusable %dx%d %s layout!", TILED_IMAGE_NAME_LEN, h->name, h->width,
+                 h->height, pixel_format_name(image->format));
+        return false;
+    }
+    for (uint32_t t = 0; t < h->tile_count; t++)
+    {
+        if (!tile_valid(image, (int)t))
+        {
+            ESP_LOGE(TAG, "Tiled image %.*s: tile %u is corrupt!", TILED_IMAGE_NAME_LEN, h->name, (unsigned)t);
+            return false;
+        }
+    }
+    return true;
+}
+
+bool tiled_image_tile_frame(const tiled_image_t *image, int t, pixel_frame_t *frame)
+{
+    if (image->tiles[t].encoding != TILED_TILE_RAW)
+        return false;
+    int x0, y0, width, height;
+    tiled_image_tile_rect(image, t, &x0, &y0, &width, &height);
+    return pixel_frame_wrap(frame, image->base + image->tiles[t].offset, image->format, width, height, 0);
+}
+
+// Calls fill for each row span of pixels first_pixel .. first_pixel +
+// pixels - 1 of a tile, in raster order
+typedef void (*span_fn)(void *ctx, int x, int y, int pixels);
+
+static void for_each_span(int x0, int y0, int width, int first_pixel, int pixels, span_fn fill, void *ctx)
+{
+    while (pixels > 0)
+    {
+        int col = first_pixel % width;
+        int span = width - col < pixels ? width - col : pixels;
+        fill(ctx, x0 + col, y0 + first_pixel / width, span);
+        first_pixel += span;
+        pixels -= span;
+    }
+}
+
+typedef struct
+{
+    uint8_t *class_map;
+    int stride;
+    uint8_t ids[2]; // class of each pixel of the unit
+} class_fill_t;
+
+static void fill_ids(void *ctx, int x, int y, int pixels)
+{
+    class_fill_t *f = (class_fill_t *)ctx;
+    uint8_t *dst = f->class_map + (size_t)y * f->stride + x;
+    if (f->ids[0] == f->ids[1])
+    {
+        memset(dst, f->ids[0], pixels);
+        return;
+    }
+    // YUV422 pairs whose two pixels differ; spans start on a pair
+    for (int i = 0; i < pixels; i++)
+        dst[i] = f->ids[i & 1];
+}
+
+static void unit_ids(const class_lut_t *lut, pixel_format_t format, const uint8_t *unit, uint8_t *ids)
+{
+    ids[0] = class_lut_lookup_at(lut, unit, 0);
+    ids[1] = format == PIXEL_FORMAT_YUV422 ? class_lut_lookup_at(lut, unit, 1) : ids[0];
+}
+
+void tiled_image_classify(const tiled_image_t *image, const class_lut_t *lut, uint8_t *class_map,
+                          tiled_image_stats_t *stats)
+{
+    int up = unit_pixels(image->format);
+    int unit_bytes = up * pixel_format_bytes(image->format);
+    class_fill_t fill = {class_map, image->width, {0, 0}};
+    memset(stats, 0, sizeof(*stats));
+
+    for (int t = 0; t < image->tiles_x * image->tiles_y; t++)
+    {
+        const tiled_image_entry_t *entry = &image->tiles[t];
+        const uint8_t *data = image->base + entry->offset;
+        int x0, y0, width, height;
+        tiled_image_tile_rect(image, t, &x0, &y0, &width, &height);
+
+        switch (entry->encoding)
+        {
+        case TILED_TILE_RAW:
+        {
+            // straight from the mapping, one tile row at a time
+            int row_bytes = width * pixel_format_bytes(image->format);
+            for (int y = 0; y < height; y++)
+            {
+                class_lut_classify_ids(lut, data + (size_t)y * row_bytes, 0, width,
+                                       class_map + (size_t)(y0 + y) * image->width + x0);
+            }
+            stats->raw_tiles++;
+            stats->classified_pixels += width * height;
+            break;
+        }
+        case TILED_TILE_UNIFORM:
+            unit_ids(lut, image->format, data, fill.ids);
+            for_each_span(x0, y0, width, 0, width * height, fill_ids, &fill);
+            stats->uniform_tiles++;
+            stats->skipped_tiles += fill.ids[0] == CLASS_NONE && fill.ids[1] == CLASS_NONE;
+            stats->classified_pixels += up;
+            break;
+        case TILED_TILE_RLE:
+        {
+            int pixel = 0;
+            for (uint32_t i = 0; i < entry->size; i += 2 + unit_bytes)
+            {
+                int count = (data[i] | data[i + 1] << 8) * up;
+                unit_ids(lut, image->format, data + i + 2, fill.ids);
+                for_each_span(x0, y0, width, pixel, count, fill_ids, &fill);
+                pixel += count;
+                stats->classified_pixels += up;
+            }
+            stats->rle_tiles++;
+            break;
+        }
+        default:
+            break;
+        }
+    }
+}
+
+typedef struct
+{
+    uint8_t *pixels;
+    int stride;
+    int bytes; // per pixel
+    const uint8_t *unit;
+    int unit_bytes;
+} pixel_fill_t;
+
+static void fill_pixels(void *ctx, int x, int y, int pixels)
+{
+    pixel_fill_t *f = (pixel_fill_t *)ctx;
+    uint8_t *dst = f->pixels + (size_t)y * f->stride + (size_t)x * f->bytes;
+    for (int i = 0; i < pixels * f->bytes; i += f->unit_bytes)
+        memcpy(dst + i, f->unit, f->unit_bytes);
+}
+
+void tiled_image_decode(const tiled_image_t *image, uint8_t *pixels, int stride)
+{
+    int bytes = pixel_format_bytes(image->format);
+    int up = unit_pixels(image->format);
+    pixel_fill_t fill = {pixels, stride, bytes, NULL, up * bytes};
+
+    for (int t = 0; t < image->tiles_x * image->tiles_y; t++)
+    {
+        const tiled_image_entry_t *entry = &image->tiles[t];
+        const uint8_t *data = image->base + entry->offset;
+        int x0, y0, width, height;
+        tiled_image_tile_rect(image, t, &x0, &y0, &width, &height);
+
+        if (entry->encoding == TILED_TILE_RAW)
+        {
+            for (int y = 0; y < height; y++)
+            {
+                memcpy(pixels + (size_t)(y0 + y) * stride + (size_t)x0 * bytes, data + (size_t)y * width * bytes,
+                       (size_t)width * bytes);
+            }
+        }
+        else if (entry->encoding == TILED_TILE_UNIFORM)
+        {
+            fill.unit = data;
+            for_each_span(x0, y0, width, 0, width * height, fill_pixels, &fill);
+        }
+        else
+        {
+            int pixel = 0;
+            for (uint32_t i = 0; i < entry->size; i += 2 + fill.unit_bytes)
+            {
+                int count = (data[i] | data[i + 1] << 8) * up;
+                fill.unit = data + i + 2;
+                for_each_span(x0, y0, width, pixel, count, fill_pixels, &fill);
+                pixel += count;
+            }
+        }
+    }
+}
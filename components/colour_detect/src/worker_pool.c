@@ -0,0 +1,231 @@
+#include <string.h>
+#include "detect_port.h"
+#include "worker_pool.h"
+
+static const char *TAG = "worker_pool";
+
+// Thin layer over the few primitives the pool needs
+#ifdef ESP_PLATFORM
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+
+#define WORKER_PRIORITY 5
+
+static void *sem_create(void)
+{
+    return xSemaphoreCreateCounting(WORKER_POOL_MAX, 0);
+}
+
+static void sem_give(void *sem)
+{
+    xSemaphoreGive((SemaphoreHandle_t)sem);
+}
+
+static void sem_take(void *sem)
+{
+    xSemaphoreTake((SemaphoreHandle_t)sem, portMAX_DELAY);
+}
+
+static void sem_delete(void *sem)
+{
+    vSemaphoreDelete((SemaphoreHandle_t)sem);
+}
+
+static bool thread_start(void **handle, void (*entry)(void *), void *arg, int index, size_t stack_size)
+{
+    return xTaskCreatePinnedToCore(entry, "frame_worker", stack_size, arg, WORKER_PRIORITY,
+                                   (TaskHandle_t *)handle, index % portNUM_PROCESSORS) == pdPASS;
+}
+
+static void thread_exit(void)
+{
+    vTaskDelete(NULL);
+}
+
+static void thread_join(void *handle)
+{
+    // workers delete themselves after signalling done
+    (void)handle;
+}
+#else
+#include <stdlib.h>
+#include <pthread.h>
+#include <semaphore.h>
+
+static void *sem_create(void)
+{
+    sem_t *sem = (sem_t *)malloc(sizeof(sem_t));
+    if (sem != NULL && sem_init(sem, 0, 0) != 0)
+    {
+        free(sem);
+        return NULL;
+    }
+    return sem;
+}
+
+static void sem_give(void *sem)
+{
+    sem_post((sem_t *)sem);
+}
+
+static void sem_take(void *sem)
+{
+    while (sem_wait((sem_t *)sem) != 0)
+    {
+        // retry on EINTR
+    }
+}
+
+static void sem_delete(void *sem)
+{
+    sem_destroy((sem_t *)sem);
+    free(sem);
+}
+
+typedef struct
+{
+    pthread_t thread;
+    void (*entry)(void *);
+    void *arg;
+} host_thread_t;
+
+static void *host_thread_entry(void *arg)
+{
+    host_thread_t *t = (host_thread_t *)arg;
+    t->entry(t->arg);
+    return NULL;
+}
+
+static bool thread_start(void **handle, void (*entry)(void *), void *arg, int index, size_t stack_size)
+{
+    (void)index;
+    (void)stack_size;
+    host_thread_t *t = (host_thread_t *)malloc(sizeof(host_thread_t));
+    if (t == NULL)
+        return false;
+    t->entry = entry;
+    t->arg = arg;
+    if (pthread_create(&t->thread, NULL, host_thread_entry, t) != 0)
+    {
+        free(t);
+        return false;
+    }
+    *handle = t;
+    return true;
+}
+
+static void thread_exit(void)
+{
+    // returning from the entry function ends the pthread, joined by handle
+}
+
+static void thread_join(void *handle)
+{
+    host_thread_t *t = (host_thread_t *)handle;
+    pthread_join(t->thread, NULL);
+    free(t);
+}
+#endif
+
+static void worker_entry(void *arg)
+{
+    worker_slot_t *slot = (worker_slot_t *)arg;
+    worker_pool_t *pool = slot->pool;
+
+    for (;;)
+    {
+        sem_take(pool->start[slot->index]);
+        if (pool->stopping)
+            break;
+        pool->job(pool->job_args + slot->index * pool->job_arg_stride);
+        sem_give(pool->done);
+    }
+
+    // worker_pool_free may free the pool, and the slot in it, once this is
+    // given: nothing below may touch either
+    sem_give(pool->done);
+    thread_exit();
+}
+
+bool worker_pool_init(worker_pool_t *pool, int count, size_t stack_size)
+{
+    memset(pool, 0, sizeof(*pool));
+    pool->stack_size = stack_size;
+    if (count < 1 || count > WORKER_POOL_MAX)
+    {
+        ESP_LOGE(TAG, "Unsupported worker count %d", count);
+        return false;
+    }
+
+    pool->done = sem_create();
+    if (pool->done == NULL)
+        return false;
+
+    for (int i = 0; i < count; i++)
+    {
+        pool->slots[i].pool = pool;
+        pool->slots[i].index = i;
+        pool->start[i] = sem_create();
+        if (pool->start[i] == NULL ||
+            !thread_start(&pool->threads[i], worker_entry, &pool->slots[i], i, pool->stack_size))
+        {
+            ESP_LOGE(TAG, "Failed to start worker %d", i);
+            if (pool->start[i] != NULL)
+                sem_delete(pool->start[i]);
+            worker_pool_free(pool);
+            return false;
+        }
+        pool->count++;
+    }
+    return true;
+}
+
+void worker_pool_free(worker_pool_t *pool)
+{
+    pool->stopping = true;
+    for (int i = 0; i < pool->count; i++)
+    {
+        sem_give(pool->start[i]);
+    }
+    for (int i = 0; i < pool->count; i++)
+    {
+        sem_take(pool->done);
+    }
+    for (int i = 0; i < pool->count; i++)
+    {
+        thread_join(pool->threads[i]);
+        sem_delete(pool->start[i]);
+    }
+    if (pool->done != NULL)
+        sem_delete(pool->done);
+    pool->count = 0;
+    pool->done = NULL;
+}
+
+void worker_pool_start(worker_pool_t *pool, worker_job_fn job, void *args, size_t arg_stride)
+{
+    pool->job = job;
+    pool->job_args = (char *)args;
+    pool->job_arg_stride = arg_stride;
+
+    // semaphore give/take pairs order the job fields before the workers read them
+    for (int i = 0; i < pool->count; i++)
+    {
+        sem_give(pool->start[i]);
+    }
+}
+
+void worker_pool_wait(worker_pool_t *pool)
+{
+    for (int i = 0; i < pool->count; i++)
+    {
+        sem_take(pool->done);
+    }
+}
+
+void worker_pool_run(worker_pool_t *pool, worker_job_fn job, void *args, size_t arg_stride)
+{
+    worker_pool_start(pool, job, args, arg_stride);
+    worker_pool_wait(pool);
+}
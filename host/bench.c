@@ -0,0 +1,1561 @@
+// Host benchmark for the detection pipeline: runs raw RGB565 frames, as is
+// or converted to another pixel format, through every pipeline, reports per-stage time, throughput and arena use, checks
+// that a warmed-up context makes no heap allocations per frame, and checks
+// the detections against golden output. Every classification kernel the host
+// can run is fuzzed against the scalar HSV path and timed against the table.
+//
+//   colour_bench [options] frame.raw ...
+//     --width W --height H    frame size (1134x805)
+//     --table PATH            colour table (main/colour_table.txt)
+//     --format NAME           convert the frames to rgb565, rgb565be, rgb888 or
+//                             yuv422 and classify them natively (rgb565)
+//     --pad N                 bytes of padding after every row, so the stride
+//                             differs from the width (0)
+//     --kernel NAME           classify without the class table, with the swar,
+//                             vector, sse2 or avx2 kernel (table)
+//     --pipeline NAME         full, parallel, stream, pyramid, morph or all (all)
+//     --workers N             parallel bands (2)
+//     --chunk N               streaming rows per chunk (8)
+//     --gap N --min-pixels N  labeling parameters (3, 50)
+//     --runs N                timed runs per frame and pipeline (10)
+//     --factor N              pyramid decimation, 4 or 8 (4)
+//     --denoise N             morph pipeline opening radius against speckle (0);
+//                             anything but 0 makes it approximate
+//     --gate N                coverage gate in front of every pipeline with N
+//                             samples, off by default (0)
+//     --gate-z Z              gate confidence in standard deviations (3)
+//     --profile FORMAT        print the profiler records of each frame's first,
+//                             untimed run as lines or json
+//     --synthetic SEED        add a generated frame with blobs of every class
+//     --sparse SEED           add a generated frame with a few small blobs
+//     --sequence N            run N frames of a static scene with one moving blob
+//                             through the temporal mode and the blob tracker
+//     --tile N --tolerance N  temporal tile size and per-channel tolerance (32, 0)
+//     --noise N               per-channel sensor noise added to sequence frames (0)
+//     --tiled PATH            run every image of a png2RGB565.py --tiled pack
+//                             through the full pipeline, tile by tile from the
+//                             mapped file and decoded, and fail if they differ
+//     --corpus DIR            run every *.raw frame of DIR (in --format) through
+//                             --pipeline, streaming by default, with the next
+//                             frame read on an I/O thread meanwhile; prints each
+//                             frame's detections, frames/s and latency
+//                             percentiles, and adds the detections to the
+//                             golden output, for threshold regression runs
+//     --no-prefetch           read corpus frames on the main thread instead
+//     --golden PATH           fail if the detections differ from PATH
+//     --write-golden PATH     write the detections to PATH
+//     --verify                check the LUT, the labeler against the flood fill
+//                             and every pipeline / worker count against each other,
+//                             and report how far the pyramid pipeline deviates;
+//                             with --format how many pixels classify differently
+//                             from the RGB565 frame (none allowed but for yuv422);
+//                             with --gate also that no skipped frame had a detection
+//
+// host/golden/detections.txt holds the expected detections for
+//   colour_bench --synthetic 1 --synthetic 2 --synthetic 3 --synthetic 4
+//                main/lutino_brightlight_rgb565.raw --golden host/golden/detections.txt
+// run from the repository root.
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "detect_port.h"
+#include "hsv.h"
+#include "class_lut.h"
+#include "pixel_mask.h"
+#include "blob_label.h"
+#include "colour_detect.h"
+#include "coverage_gate.h"
+#include "detect_prof.h"
+#include "worker_pool.h"
+#include "frame_pyramid.h"
+#include "frame_temporal.h"
+#include "pixel_morph.h"
+#include "blob_track.h"
+#include "detector.h"
+#include "tiled_image.h"
+#include "frame_corpus.h"
+
+static const char *TAG = "bench";
+
+#define MAX_FRAMES 32
+
+typedef struct
+{
+    char name[64];
+    uint16_t *pixels;   // RGB565 as loaded or generated
+    pixel_frame_t image; // the same frame in --format, what the pipelines see
+} frame_t;
+
+// Growable text buffer for the detection dump
+typedef struct
+{
+    char *data;
+    size_t len;
+    size_t cap;
+} text_t;
+
+static void text_printf(text_t *text, const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+
+static void text_printf(text_t *text, const char *fmt, ...)
+{
+    va_list args;
+    va_start(args, fmt);
+    int need = vsnprintf(NULL, 0, fmt, args);
+    va_end(args);
+    if (text->len + need + 1 > text->cap)
+    {
+        text->cap = (text->len + need + 1) * 2;
+        text->data = realloc(text->data, text->cap);
+    }
+    va_start(args, fmt);
+    vsnprintf(text->data + text->len, need + 1, fmt, args);
+    va_end(args);
+    text->len += need;
+}
+
+static char *read_file(const char *path, size_t *size)
+{
+    FILE *f = fopen(path, "rb");
+    if (f == NULL)
+        return NULL;
+    fseek(f, 0, SEEK_END);
+    long len = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    char *data = malloc(len + 1);
+    if (data != NULL && fread(data, 1, len, f) != (size_t)len)
+    {
+        free(data);
+        data = NULL;
+    }
+    fclose(f);
+    if (data != NULL)
+    {
+        data[len] = '\0';
+        if (size != NULL)
+            *size = len;
+    }
+    return data;
+}
+
+static uint32_t xorshift32(uint32_t *state)
+{
+    uint32_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return *state = x;
+}
+
+// Scattered noise pixels plus filled ellipses with holes, in the first
+// RGB565 value of each class so the frame exercises every class. Sparse
+// frames have a few small blobs on a nearly empty background.
+static int class_colours(const class_lut_t *lut, uint16_t *colours)
+{
+    int colour_count = 0;
+    for (int c = 1; c <= lut->class_count; c++)
+    {
+        for (int v = 0; v < CLASS_LUT_SIZE; v++)
+        {
+            if (class_lut_lookup(lut, (uint16_t)v) == c)
+            {
+                colours[colour_count++] = (uint16_t)v;
+                break;
+            }
+        }
+    }
+    return colour_count;
+}
+
+static void fill_ellipse(uint16_t *pixels, int width, int height, int cx, int cy, int rx, int ry,
+                         uint16_t colour, int drop, uint32_t *state)
+{
+    for (int y = cy - ry; y <= cy + ry; y++)
+    {
+        for (int x = cx - rx; x <= cx + rx; x++)
+        {
+            if (x < 0 || y < 0 || x >= width || y >= height)
+                continue;
+            double dx = (double)(x - cx) / rx;
+            double dy = (double)(y - cy) / ry;
+            if (dx * dx + dy * dy <= 1.0 && (int)(xorshift32(state) % 10) >= drop)
+                pixels[y * width + x] = colour;
+        }
+    }
+}
+
+static uint16_t *synthetic_frame(const class_lut_t *lut, int width, int height, uint32_t seed,
+                                 bool sparse)
+{
+    uint16_t colours[CLASS_LUT_MAX_CLASSES];
+    int colour_count = class_colours(lut, colours);
+
+    uint16_t *pixels = calloc((size_t)width * height, sizeof(uint16_t));
+    uint32_t state = seed * 2654435761u + 1;
+    if (colour_count == 0)
+        return pixels;
+
+    for (int i = 0; i < width * height; i++)
+    {
+        if (xorshift32(&state) % (sparse ? 20000 : 1000) == 0)
+            pixels[i] = colours[xorshift32(&state) % colour_count];
+    }
+    int blob_count = sparse ? 1 + xorshift32(&state) % 3 : 5 + xorshift32(&state) % 10;
+    int scale = sparse ? 24 : 4;
+    for (int b = 0; b < blob_count; b++)
+    {
+        int cx = xorshift32(&state) % width;
+        int cy = xorshift32(&state) % height;
+        int rx = 10 + xorshift32(&state) % (width / scale);
+        int ry = 10 + xorshift32(&state) % (height / scale);
+        uint16_t colour = colours[xorshift32(&state) % colour_count];
+        int drop = xorshift32(&state) % 4;
+        fill_ellipse(pixels, width, height, cx, cy, rx, ry, colour, drop, &state);
+    }
+    return pixels;
+}
+
+static void dump_result(text_t *text, const char *frame_name, const colour_registry_t *reg,
+                        const frame_result_t *result)
+{
+    text_printf(text, "frame %s%s\n", frame_name, result->gated ? " gated" : "");
+    for (int c = 0; c < reg->count; c++)
+    {
+        const class_result_t *cls = &result->classes[c];
+        text_printf(text, "class %s pixels %d percent %.2f blobs %d rejected %d dropped %d detected %d\n",
+                    reg->classes[c].name, cls->pixel_count, cls->percent, cls->blob_count,
+                    cls->rejected_count, cls->dropped_count, cls->detected ? cls->detected_blob : -1);
+        for (int i = 0; i < cls->blob_count; i++)
+        {
+            const blob_t *blob = &cls->blobs[i].blob;
+            text_printf(text, "  blob %d %d %d %d %d %d %d\n", blob->x_center, blob->y_center,
+                        blob->pixel_count, blob->min_x, blob->max_x, blob->min_y, blob->max_y);
+        }
+    }
+}
+
+// Times the run labeler against the original flood fill on one class of a
+// class map and checks that both report the same blobs
+static void rgb565_to_rgb888(uint16_t p, int *r, int *g, int *b)
+{
+    int r5 = p >> 11, g6 = (p >> 5) & 0x3F, b5 = p & 0x1F;
+    // top bits replicated into the low ones, so truncating gives p back
+    *r = r5 << 3 | r5 >> 2;
+    *g = g6 << 2 | g6 >> 4;
+    *b = b5 << 3 | b5 >> 2;
+}
+
+static uint8_t clamp_byte(int v)
+{
+    return v < 0 ? 0 : v > 255 ? 255 : (uint8_t)v;
+}
+
+// The RGB565 frame in another format with pad bytes of junk after every row.
+// RGB565 big-endian and RGB888 hold exactly the same colours; YUV422 is
+// BT.601 full range with U and V averaged per pixel pair, so it is lossy.
+static bool convert_frame(const uint16_t *pixels, int width, int height, pixel_format_t format, int pad,
+                          pixel_frame_t *image)
+{
+    int stride = width * pixel_format_bytes(format) + pad;
+    uint8_t *data = malloc((size_t)stride * height);
+    if (data == NULL || !pixel_frame_wrap(image, data, format, width, height, stride))
+    {
+        free(data);
+        return false;
+    }
+    memset(data, 0xA5, (size_t)stride * height);
+
+    for (int y = 0; y < height; y++)
+    {
+        const uint16_t *src = pixels + (size_t)y * width;
+        uint8_t *dst = data + (size_t)y * stride;
+        int r, g, b;
+        switch (format)
+        {
+        case PIXEL_FORMAT_RGB565:
+            memcpy(dst, src, width * sizeof(uint16_t));
+            break;
+        case PIXEL_FORMAT_RGB565_BE:
+            for (int x = 0; x < width; x++)
+            {
+                dst[2 * x] = src[x] >> 8;
+                dst[2 * x + 1] = src[x] & 0xFF;
+            }
+            break;
+        case PIXEL_FORMAT_RGB888:
+            for (int x = 0; x < width; x++)
+            {
+                rgb565_to_rgb888(src[x], &r, &g, &b);
+                dst[3 * x] = r;
+                dst[3 * x + 1] = g;
+                dst[3 * x + 2] = b;
+            }
+            break;
+        case PIXEL_FORMAT_YUV422:
+            for (int x = 0; x < width; x += 2)
+            {
+                int u = 0, v = 0;
+                for (int i = 0; i < 2; i++)
+                {
+                    rgb565_to_rgb888(src[x + i], &r, &g, &b);
+                    dst[2 * (x + i)] = clamp_byte((19595 * r + 38470 * g + 7471 * b + 32768) >> 16);
+                    u += -11059 * r - 21709 * g + 32768 * b;
+                    v += 32768 * r - 27439 * g - 5329 * b;
+                }
+                dst[2 * x + 1] = clamp_byte(128 + ((u + 65536) >> 17));
+                dst[2 * x + 3] = clamp_byte(128 + ((v + 65536) >> 17));
+            }
+            break;
+        default:
+            break;
+        }
+    }
+    return true;
+}
+
+static bool compare_flood_fill(const uint8_t *class_map, int width, int height, int max_gap,
+                               int min_pixels, int class_id, const char *name)
+{
+    blob_t flood_blobs[DETECT_MAX_BLOBS];
+    blob_t run_blobs[DETECT_MAX_BLOBS];
+    int run_count = 0;
+
+    pixel_mask_t mask;
+    if (!pixel_mask_init(&mask, width, height, MALLOC_CAP_SPIRAM))
+        return false;
+    for (int i = 0; i < width * height; i++)
+    {
+        if (class_map[i] == class_id)
+            pixel_mask_set(&mask, i % width, i / width);
+    }
+
+    int64_t t0 = esp_timer_get_time();
+    int flood_count = find_blobs_flood(&mask, max_gap, min_pixels, flood_blobs, DETECT_MAX_BLOBS);
+    int64_t t1 = esp_timer_get_time();
+
+    blob_labeler_t labeler;
+    if (!blob_labeler_init(&labeler, width, height, max_gap))
+    {
+        pixel_mask_free(&mask);
+        return false;
+    }
+    for (int y = 0; y < height; y++)
+    {
+        blob_labeler_push_row(&labeler, pixel_mask_row(&mask, y));
+    }
+    const blob_label_stats_t *stats;
+    int cursor = 0;
+    while ((stats = blob_labeler_next(&labeler, &cursor)) != NULL)
+    {
+        if (stats->pixel_count >= min_pixels && run_count < DETECT_MAX_BLOBS)
+            blob_label_to_blob(stats, &run_blobs[run_count++]);
+    }
+    int64_t t2 = esp_timer_get_time();
+    blob_labeler_free(&labeler);
+
+    // Gaps bridged by dilation, then only 8-connectivity; frame_result_add
+    // puts the blobs in first-pixel order
+    pixel_mask_t bridged;
+    frame_result_t morph;
+    frame_result_reset(&morph, 1, min_pixels);
+    if (!pixel_mask_init(&bridged, width, height, MALLOC_CAP_SPIRAM) ||
+        !blob_labeler_init(&labeler, width, height, 1) ||
+        !blob_labeler_set_retire(&labeler, frame_result_add, &morph))
+    {
+        pixel_mask_free(&mask);
+        return false;
+    }
+    int64_t t3 = esp_timer_get_time();
+    pixel_morph_dilate_box(&mask, &bridged, pixel_morph_gap_box(max_gap));
+    for (int y = 0; y < height; y++)
+    {
+        blob_labeler_push_bridged_row(&labeler, pixel_mask_row(&bridged, y), pixel_mask_row(&mask, y), 1);
+    }
+    blob_labeler_flush(&labeler);
+    int64_t t4 = esp_timer_get_time();
+    blob_labeler_free(&labeler);
+    pixel_mask_free(&bridged);
+    pixel_mask_free(&mask);
+
+    bool same = flood_count == run_count &&
+                memcmp(flood_blobs, run_blobs, run_count * sizeof(blob_t)) == 0;
+    // past PIXEL_MORPH_MAX_GAP the gap box is capped, so the morph pipeline refuses such gaps
+    bool morph_exact = max_gap <= PIXEL_MORPH_MAX_GAP;
+    bool morph_same = !morph_exact || morph.classes[0].blob_count == flood_count;
+    for (int i = 0; morph_exact && morph_same && i < flood_count; i++)
+    {
+        morph_same = memcmp(&morph.classes[0].blobs[i].blob, &flood_blobs[i], sizeof(blob_t)) == 0;
+    }
+    printf("  %s labeling: flood fill %lld us, run labeler %lld us, morphology %lld us, %d blobs, results %s\n",
+           name, (long long)(t1 - t0), (long long)(t2 - t1), (long long)(t4 - t3), run_count,
+           same && morph_same ? "identical" : "DIFFER");
+    return same && morph_same;
+}
+
+// Blobs of the pyramid result that match the full-resolution result exactly,
+// the largest coverage error and whether the verdicts agree
+static void compare_pyramid(const frame_result_t *full, const frame_result_t *pyramid,
+                            const colour_registry_t *reg, const frame_pyramid_t *fp)
+{
+    for (int c = 0; c < reg->count; c++)
+    {
+        const class_result_t *a = &full->classes[c];
+        const class_result_t *b = &pyramid->classes[c];
+        int matched = 0;
+        for (int i = 0; i < a->blob_count; i++)
+        {
+            for (int j = 0; j < b->blob_count; j++)
+            {
+                if (memcmp(&a->blobs[i].blob, &b->blobs[j].blob, sizeof(blob_t)) == 0)
+                {
+                    matched++;
+                    break;
+                }
+            }
+        }
+        printf("  %s pyramid 1/%d: %s, %.1f%% refined, %d/%d blobs exact, %d extra, "
+               "coverage %.2f%% vs %.2f%%, verdict %s\n",
+               reg->classes[c].name, fp->factor, fp->full_frame ? "full frame" : "boxes",
+               100.0 * fp->refined_pixels / ((double)fp->width * fp->height), matched,
+               a->blob_count, b->blob_count - matched, b->percent, a->percent,
+               a->detected == b->detected ? "same" : "DIFFERS");
+    }
+}
+
+// lut is built for the frame's image format, rgb565_lut for its RGB565 pixels
+static bool verify_frame(const frame_t *frame, const detector_config_t *base, coverage_gate_t *gate,
+                         const colour_registry_t *reg, const class_lut_t *lut, const class_lut_t *rgb565_lut)
+{
+    bool ok = true;
+    int width = base->width;
+    int height = base->height;
+
+    printf("verify %s\n", frame->name);
+    uint8_t *class_map = malloc((size_t)width * height);
+    for (int y = 0; y < height; y++)
+    {
+        class_lut_classify_ids(lut, pixel_frame_row(&frame->image, y), 0, width, class_map + (size_t)y * width);
+    }
+    if (lut != rgb565_lut)
+    {
+        // Lossless formats must classify exactly like the RGB565 frame
+        int differ = 0;
+        for (int i = 0; i < width * height; i++)
+        {
+            differ += class_map[i] != class_lut_lookup(rgb565_lut, frame->pixels[i]);
+        }
+        bool exact = lut->format != PIXEL_FORMAT_YUV422;
+        printf("  %s frame: %d pixels (%.3f%%) classified differently from rgb565%s\n",
+               pixel_format_name(lut->format), differ, 100.0 * differ / ((double)width * height),
+               exact && differ > 0 ? ", DIFFER" : "");
+        ok &= !exact || differ == 0;
+    }
+    for (int c = 0; c < reg->count; c++)
+    {
+        ok &= compare_flood_fill(class_map, width, height, base->max_gap, base->min_pixels,
+                                 c + 1, reg->classes[c].name);
+    }
+    free(class_map);
+
+    // Every pipeline and band count must give the full-frame result
+    text_t reference = {0};
+    detector_config_t cfg = *base;
+    frame_result_t result;
+    cfg.pipeline = DETECTOR_FULL_FRAME;
+    if (!detector_process(&cfg, reg, lut, &frame->image, &result, NULL))
+        return false;
+    dump_result(&reference, frame->name, reg, &result);
+
+    for (int variant = -1; variant <= WORKER_POOL_MAX; variant++)
+    {
+        cfg = *base;
+        if (variant < 0)
+        {
+            if (base->max_gap > PIXEL_MORPH_MAX_GAP)
+                continue;
+            cfg.pipeline = DETECTOR_MORPH;
+            cfg.denoise_radius = 0;
+        }
+        else if (variant == 0)
+        {
+            cfg.pipeline = DETECTOR_STREAMING;
+        }
+        else
+        {
+            cfg.pipeline = DETECTOR_PARALLEL;
+            cfg.workers = variant;
+        }
+        text_t text = {0};
+        bool same = detector_process(&cfg, reg, lut, &frame->image, &result, NULL);
+        dump_result(&text, frame->name, reg, &result);
+        same = same && text.len == reference.len && memcmp(text.data, reference.data, text.len) == 0;
+        if (!same)
+        {
+            printf("  %s pipeline (%d workers) DIFFERS from full frame\n",
+                   detector_pipeline_name(cfg.pipeline), cfg.workers);
+            ok = false;
+        }
+        free(text.data);
+    }
+    printf("  pipelines %s\n", ok ? "identical" : "DIFFER");
+    free(reference.data);
+
+    // Morph at the widest gap its box reaches must still match the full
+    // frame, and one pixel wider must be refused rather than capped
+    text_t wide = {0};
+    text_t wide_morph = {0};
+    cfg = *base;
+    cfg.max_gap = PIXEL_MORPH_MAX_GAP;
+    bool wide_ok = detector_process(&cfg, reg, lut, &frame->image, &result, NULL);
+    dump_result(&wide, frame->name, reg, &result);
+    cfg.pipeline = DETECTOR_MORPH;
+    cfg.denoise_radius = 0;
+    wide_ok = wide_ok && detector_process(&cfg, reg, lut, &frame->image, &result, NULL);
+    dump_result(&wide_morph, frame->name, reg, &result);
+    wide_ok = wide_ok && wide.len == wide_morph.len && memcmp(wide.data, wide_morph.data, wide.len) == 0;
+    cfg.max_gap = PIXEL_MORPH_MAX_GAP + 1;
+    bool refused = !detector_process(&cfg, reg, lut, &frame->image, &result, NULL);
+    printf("  morph at gap %d %s full frame, gap %d %s\n", PIXEL_MORPH_MAX_GAP, wide_ok ? "matches" : "DIFFERS from",
+           PIXEL_MORPH_MAX_GAP + 1, refused ? "refused" : "ACCEPTED");
+    ok &= wide_ok && refused;
+    free(wide.data);
+    free(wide_morph.data);
+
+    // The pyramid is only held to its documented tolerance, so report rather than fail
+    frame_result_t full;
+    frame_pyramid_t frame_pyramid;
+    cfg = *base;
+    cfg.pipeline = DETECTOR_FULL_FRAME;
+    if (!detector_process(&cfg, reg, lut, &frame->image, &full, NULL) ||
+        !frame_pyramid_init(&frame_pyramid, width, height, base->max_gap, base->min_pixels,
+                            base->pyramid_factor, NULL))
+        return false;
+    bool pyramid_ok = frame_pyramid_process(&frame_pyramid, &frame->image, lut, &result);
+    colour_detect_evaluate(reg, &result, width * height);
+    if (pyramid_ok)
+        compare_pyramid(&full, &result, reg, &frame_pyramid);
+    frame_pyramid_free(&frame_pyramid);
+
+    // A frame the gate skips must not have had a detectable class
+    if (gate != NULL)
+    {
+        frame_result_reset(&result, lut->class_count, base->min_pixels);
+        bool skip = coverage_gate_check(gate, reg, lut, &frame->image, &result);
+        bool detectable = false;
+        printf("  coverage gate %d samples: %s", gate->sample_count, skip ? "skip" : "pass");
+        for (int c = 0; c < reg->count; c++)
+        {
+            // pixel counts are only filled on a skip, so report the bound itself
+            const class_result_t *cls = &full.classes[c];
+            detectable |= cls->percent >= reg->classes[c].min_percent;
+            printf(", %s %.2f%%", reg->classes[c].name, cls->percent);
+            if (skip)
+                printf(" (estimate %.2f%%)", 100.0 * result.classes[c].pixel_count / ((double)width * height));
+        }
+        printf("%s\n", skip && detectable ? ", FALSE SKIP" : "");
+        if (skip && detectable)
+            ok = false;
+    }
+    return ok && pyramid_ok;
+}
+
+// Moves a blob of the first class left to right across a static sparse
+// scene, optionally with per-channel sensor noise on every pixel. Checks the
+// temporal mode against the streaming pipeline on every frame and that the
+// tracker keeps one id for the moving blob, and that temporal frames after the
+// first allocate nothing from the heap.
+static bool run_sequence(const detector_config_t *cfg, const frame_temporal_config_t *temporal,
+                         int frame_count, int noise, const colour_registry_t *reg, const class_lut_t *lut)
+{
+    int width = cfg->width;
+    int height = cfg->height;
+    uint16_t colours[CLASS_LUT_MAX_CLASSES];
+    if (class_colours(lut, colours) == 0)
+        return false;
+
+    uint16_t *background = synthetic_frame(lut, width, height, 1, true);
+    uint16_t *pixels = malloc((size_t)width * height * sizeof(uint16_t));
+    pixel_frame_t image;
+    pixel_frame_wrap(&image, pixels, PIXEL_FORMAT_RGB565, width, height, 0);
+    // reference, class map and row runs with room to grow, plus a labeler
+    size_t pixel_count = (size_t)width * height;
+    detect_arena_t arena;
+    frame_temporal_t ft;
+    blob_tracker_t tracker;
+    if (!detect_arena_init(&arena, 64 * 1024 + width + height,
+                           3 * pixel_count + (size_t)height * (sizeof(temporal_row_t) + 64 * sizeof(blob_run_t)) +
+                               256 * 1024))
+        return false;
+    if (!frame_temporal_init(&ft, width, height, cfg->max_gap, cfg->min_pixels, temporal, &arena))
+    {
+        detect_arena_destroy(&arena);
+        return false;
+    }
+    blob_tracker_init(&tracker, 64, 3);
+
+    bool exact = temporal->pixel_tolerance == 0 && temporal->tile_threshold == 0;
+    bool ok = true;
+    int identical = 0;
+    int mover_id = 0;
+    int mover_switches = 0;
+    int64_t temporal_us = 0;
+    int64_t full_us = 0;
+    int64_t dirty_tiles = 0;
+    size_t allocs = 0;
+    uint32_t state = 12345;
+
+    for (int f = 0; f < frame_count; f++)
+    {
+        memcpy(pixels, background, (size_t)width * height * sizeof(uint16_t));
+        int mover_x = 60 + f * (width - 120) / (frame_count > 1 ? frame_count - 1 : 1);
+        int mover_y = height / 2;
+        fill_ellipse(pixels, width, height, mover_x, mover_y, 24, 16, colours[0], 1, &state);
+        if (noise > 0)
+        {
+            for (int i = 0; i < width * height; i++)
+            {
+                uint16_t p = pixels[i];
+                int g = ((p >> 5) & 0x3F) + (int)(xorshift32(&state) % (2 * noise + 1)) - noise;
+                g = g < 0 ? 0 : g > 0x3F ? 0x3F : g;
+                pixels[i] = (uint16_t)((p & ~(0x3F << 5)) | (g << 5));
+            }
+        }
+
+        port_heap_stats_t after;
+        port_heap_reset_peak();
+        int64_t t0 = esp_timer_get_time();
+        if (!frame_temporal_process(&ft, pixels, lut))
+        {
+            ok = false;
+            break;
+        }
+        colour_detect_evaluate(reg, &ft.result, width * height);
+        int64_t t1 = esp_timer_get_time();
+        port_heap_stats(&after);
+        // the first frame classifies everything and sizes the tables
+        if (f > 0)
+            allocs += after.alloc_count;
+        blob_tracker_update(&tracker, &ft.result);
+
+        frame_result_t full;
+        detector_config_t stream = *cfg;
+        stream.pipeline = DETECTOR_STREAMING;
+        detector_timing_t timing;
+        if (!detector_process(&stream, reg, lut, &image, &full, &timing))
+        {
+            ok = false;
+            break;
+        }
+        temporal_us += t1 - t0;
+        full_us += timing.total_us;
+        dirty_tiles += ft.dirty_tiles;
+
+        text_t a = {0}, b = {0};
+        dump_result(&a, "sequence", reg, &ft.result);
+        dump_result(&b, "sequence", reg, &full);
+        bool same = a.len == b.len && memcmp(a.data, b.data, a.len) == 0;
+        identical += same;
+        if (exact && !same)
+        {
+            printf("sequence frame %d: temporal result DIFFERS from full frame\n", f);
+            ok = false;
+        }
+        free(a.data);
+        free(b.data);
+
+        // the mover is the first-class blob whose box holds its centre
+        const class_result_t *cls = &ft.result.classes[0];
+        for (int i = 0; i < cls->blob_count; i++)
+        {
+            const blob_t *blob = &cls->blobs[i].blob;
+            if (mover_x >= blob->min_x && mover_x <= blob->max_x &&
+                mover_y >= blob->min_y && mover_y <= blob->max_y)
+            {
+                if (mover_id != 0 && tracker.ids[0][i] != mover_id)
+                    mover_switches++;
+                mover_id = tracker.ids[0][i];
+                break;
+            }
+        }
+    }
+
+    int tile_count = ft.tiles_x * ft.tiles_y;
+    printf("sequence %d frames, %dpx tiles, tolerance %d, noise %d: temporal %.3f ms vs full %.3f ms per frame, "
+           "%.1f%% tiles reclassified, %d/%d frames identical, mover track %d with %d id switches, %d tracks started, "
+           "%zu allocations after the first frame\n",
+           frame_count, temporal->tile_size, temporal->pixel_tolerance, noise,
+           temporal_us / 1000.0 / frame_count, full_us / 1000.0 / frame_count,
+           100.0 * dirty_tiles / ((double)tile_count * frame_count), identical, frame_count, mover_id,
+           mover_switches, tracker.next_id - 1, allocs);
+    if (mover_switches > 0 || allocs > 0)
+        ok = false;
+
+    frame_temporal_free(&ft);
+    detect_arena_destroy(&arena);
+    free(pixels);
+    free(background);
+    return ok;
+}
+
+typedef struct
+{
+    int64_t gate_us;
+    int64_t classify_us;
+    int64_t label_us;
+    int64_t evaluate_us;
+    int64_t total_us;
+    int64_t total_min_us;
+    size_t allocs;
+} bench_stats_t;
+
+// A threshold range that is sometimes open at either end and sometimes empty
+static void random_range(uint32_t *seed, int span, uint8_t *min, uint8_t *max)
+{
+    uint32_t r = xorshift32(seed);
+    *min = (r & 3) == 0 ? 0 : (uint8_t)((r >> 8) % 256);
+    *max = (r & 12) == 0 ? 255 : (uint8_t)(*min + (r >> 16) % span);
+}
+
+// Each image of a pack from png2RGB565.py --tiled, through the full-frame
+// pipeline twice: classified tile by tile where it is mapped, and decoded
+// into an ordinary frame first. Both must detect the same.
+static bool run_tiled(const char *path, const detector_config_t *base, const colour_registry_t *reg,
+                      const char *kernel_name, class_kernel_variant_t kernel, int runs)
+{
+    tiled_pack_t pack;
+    if (!tiled_pack_map(&pack, path))
+        return false;
+
+    color_threshold_t thresholds[CLASS_LUT_MAX_CLASSES];
+    colour_registry_thresholds(reg, thresholds);
+    bool ok = true;
+    int images = 0;
+    size_t offset = 0;
+    tiled_image_t image;
+    while (ok && tiled_pack_next(&pack, &offset, &image))
+    {
+        const tiled_image_header_t *h = image.header;
+        detector_config_t cfg = *base;
+        cfg.pipeline = DETECTOR_FULL_FRAME;
+        cfg.width = image.width;
+        cfg.height = image.height;
+        cfg.gate = NULL;
+        cfg.prof = NULL;
+
+        bool use_kernel = strcmp(kernel_name, "table") != 0;
+        int stride = image.width * pixel_format_bytes(image.format);
+        uint8_t *pixels = malloc((size_t)stride * image.height);
+        class_lut_t lut;
+        detector_t det;
+        pixel_frame_t frame;
+        if (pixels == NULL ||
+            !class_lut_init_format(&lut, use_kernel ? CLASS_LUT_MEM_NONE : CLASS_LUT_MEM_INTERNAL, image.format))
+        {
+            free(pixels);
+            ok = false;
+            break;
+        }
+        if (use_kernel)
+            class_lut_set_kernel(&lut, kernel);
+        class_lut_update(&lut, thresholds, reg->count);
+        tiled_image_decode(&image, pixels, stride);
+        pixel_frame_wrap(&frame, pixels, image.format, image.width, image.height, stride);
+        if (!detector_init(&det, &cfg, &lut, NULL))
+        {
+            free(pixels);
+            class_lut_free(&lut);
+            ok = false;
+            break;
+        }
+
+        char name[TILED_IMAGE_NAME_LEN + 1];
+        snprintf(name, sizeof(name), "%.*s", TILED_IMAGE_NAME_LEN, h->name);
+        text_t tiled_dump = {0};
+        text_t flat_dump = {0};
+        frame_result_t result;
+        tiled_image_stats_t stats;
+        int64_t tiled_us = 0;
+        int64_t flat_us = 0;
+        for (int r = 0; r <= runs && ok; r++)
+        {
+            // run 0 is the untimed warm-up that produces the detections
+            detector_timing_t timing;
+            ok &= detector_run_tiled(&det, reg, &lut, &image, &result, &timing, &stats);
+            if (r == 0)
+                dump_result(&tiled_dump, name, reg, &result);
+            else
+                tiled_us += timing.total_us;
+            ok &= detector_run(&det, reg, &lut, &frame, &result, &timing);
+            if (r == 0)
+                dump_result(&flat_dump, name, reg, &result);
+            else
+                flat_us += timing.total_us;
+        }
+        bool same = ok && tiled_dump.len == flat_dump.len &&
+                    memcmp(tiled_dump.data, flat_dump.data, tiled_dump.len) == 0;
+        size_t raw_bytes = (size_t)stride * image.height;
+        printf("tiled %-16s %dx%d %s %dx%d tiles: %d raw %d rle %d uniform (%d skipped), %5.1f%% of raw size, "
+               "%5.1f%% of pixels looked up, %7.3f ms against %7.3f ms decoded, detections %s\n",
+               name, image.width, image.height, pixel_format_name(image.format), h->tile_width, h->tile_height,
+               stats.raw_tiles, stats.rle_tiles, stats.uniform_tiles, stats.skipped_tiles,
+               100.0 * h->total_size / raw_bytes,
+               100.0 * stats.classified_pixels / ((double)image.width * image.height),
+               tiled_us / 1000.0 / runs, flat_us / 1000.0 / runs, same ? "match" : "DIFFER");
+        if (!same)
+        {
+            printf("--- tiled ---\n%.*s--- decoded ---\n%.*s", (int)tiled_dump.len, tiled_dump.data,
+                   (int)flat_dump.len, flat_dump.data);
+            ok = false;
+        }
+        free(tiled_dump.data);
+        free(flat_dump.data);
+        detector_free(&det);
+        class_lut_free(&lut);
+        free(pixels);
+        images++;
+    }
+    if (images == 0)
+    {
+        ESP_LOGE(TAG, "No tiled images in %s!", path);
+        ok = false;
+    }
+    tiled_pack_unmap(&pack);
+    return ok;
+}
+
+// The table-backed hot path against rgb565_to_hsv + matches_threshold with
+// first match winning, computed here rather than by the table builder: all
+// 65536 colours as one row in RGB565, byte-swapped RGB565 and RGB888 (whose
+// bit-replicated channels truncate back to the same colour), through
+// class_lut_classify_ids, class_lut_classify_row and class_lut_lookup_at,
+// for random threshold sets
+static int fuzz_tables(uint32_t seed, int sets)
+{
+    static const pixel_format_t formats[] = {PIXEL_FORMAT_RGB565, PIXEL_FORMAT_RGB565_BE, PIXEL_FORMAT_RGB888};
+    static uint8_t expect[CLASS_LUT_SIZE];
+    static uint8_t ids[CLASS_LUT_SIZE];
+    uint8_t *row = malloc(CLASS_LUT_SIZE * 3);
+    pixel_mask_t masks[CLASS_LUT_MAX_CLASSES];
+    int mask_count = 0;
+    int mismatches = 0;
+    bool ok = row != NULL;
+    for (; ok && mask_count < CLASS_LUT_MAX_CLASSES; mask_count++)
+        ok = pixel_mask_init(&masks[mask_count], CLASS_LUT_SIZE, 1, MALLOC_CAP_SPIRAM);
+
+    for (int set = 0; ok && set < sets; set++)
+    {
+        color_threshold_t thresholds[CLASS_LUT_MAX_CLASSES];
+        int count = 1 + xorshift32(&seed) % CLASS_LUT_MAX_CLASSES;
+        for (int c = 0; c < count; c++)
+        {
+            random_range(&seed, 100, &thresholds[c].h_min, &thresholds[c].h_max);
+            random_range(&seed, 256, &thresholds[c].s_min, &thresholds[c].s_max);
+            random_range(&seed, 256, &thresholds[c].v_min, &thresholds[c].v_max);
+        }
+        for (int i = 0; i < CLASS_LUT_SIZE; i++)
+        {
+            hsv_t hsv = rgb565_to_hsv((uint16_t)i);
+            expect[i] = 0;
+            for (int c = 0; c < count && expect[i] == 0; c++)
+            {
+                if (matches_threshold(hsv, thresholds[c]))
+                    expect[i] = c + 1;
+            }
+        }
+
+        for (size_t f = 0; ok && f < sizeof(formats) / sizeof(formats[0]); f++)
+        {
+            for (int i = 0; i < CLASS_LUT_SIZE; i++)
+            {
+                int r, g, b;
+                switch (formats[f])
+                {
+                case PIXEL_FORMAT_RGB565:
+                    row[2 * i] = i & 0xFF;
+                    row[2 * i + 1] = i >> 8;
+                    break;
+                case PIXEL_FORMAT_RGB565_BE:
+                    row[2 * i] = i >> 8;
+                    row[2 * i + 1] = i & 0xFF;
+                    break;
+                default:
+                    rgb565_to_rgb888((uint16_t)i, &r, &g, &b);
+                    row[3 * i] = r;
+                    row[3 * i + 1] = g;
+                    row[3 * i + 2] = b;
+                    break;
+                }
+            }
+
+            class_lut_t lut;
+            if (!class_lut_init_format(&lut, CLASS_LUT_MEM_INTERNAL, formats[f]))
+            {
+                ok = false;
+                break;
+            }
+            class_lut_update(&lut, thresholds, count);
+            class_lut_classify_ids(&lut, row, 0, CLASS_LUT_SIZE, ids);
+            for (int c = 0; c < count; c++)
+                pixel_mask_clear(&masks[c]);
+            class_lut_classify_row(&lut, row, 0, masks);
+            for (int i = 0; i < CLASS_LUT_SIZE; i++)
+            {
+                bool bad = ids[i] != expect[i] || class_lut_lookup_at(&lut, row, i) != expect[i];
+                for (int c = 0; c < count; c++)
+                    bad |= pixel_mask_test(&masks[c], i, 0) != (expect[i] == c + 1);
+                mismatches += bad;
+            }
+            class_lut_free(&lut);
+        }
+    }
+
+    for (int c = 0; c < mask_count; c++)
+        pixel_mask_free(&masks[c]);
+    free(row);
+    if (!ok)
+    {
+        ESP_LOGE(TAG, "Failed to set up the table check!");
+        return 1;
+    }
+    printf("class tables rgb565 rgb565be rgb888: %d mismatches against rgb565_to_hsv + matches_threshold over "
+           "%d random threshold sets\n", mismatches, sets);
+    return mismatches;
+}
+
+// A directory of captured frames through one detector. Detections go to
+// dump, one line per frame to stdout, then throughput and the latency
+// spread; like bench_pipeline it fails on heap use in the frame loop.
+static bool run_corpus(const char *dir, const detector_config_t *cfg, const colour_registry_t *reg,
+                       const class_lut_t *lut, pixel_format_t format, bool prefetch, text_t *dump)
+{
+    frame_corpus_t corpus;
+    detector_t det;
+    if (!frame_corpus_open(&corpus, dir, format, cfg->width, cfg->height, MALLOC_CAP_SPIRAM, prefetch))
+        return false;
+    if (!detector_init(&det, cfg, lut, NULL))
+    {
+        frame_corpus_close(&corpus);
+        return false;
+    }
+
+    bool ok = true;
+    size_t allocs = 0;
+    pixel_frame_t frame;
+    const char *name;
+    while (frame_corpus_next(&corpus, &frame, &name))
+    {
+        frame_result_t result;
+        detector_timing_t timing;
+        port_heap_stats_t after;
+        port_heap_reset_peak();
+        bool processed = detector_run(&det, reg, lut, &frame, &result, &timing);
+        port_heap_stats(&after);
+        allocs += after.alloc_count;
+        if (!processed)
+        {
+            ESP_LOGE(TAG, "%s pipeline failed on %s!", detector_pipeline_name(cfg->pipeline), name);
+            frame_corpus_fail(&corpus);
+            ok = false;
+            continue;
+        }
+        frame_corpus_record(&corpus, timing.total_us);
+        dump_result(dump, name, reg, &result);
+
+        printf("corpus %-24s %8.3f ms%s", name, timing.total_us / 1000.0, result.gated ? "  gated" : "");
+        int detected = 0;
+        for (int c = 0; c < reg->count; c++)
+        {
+            const class_result_t *cls = &result.classes[c];
+            if (!cls->detected)
+                continue;
+            const blob_t *blob = &cls->blobs[cls->detected_blob].blob;
+            printf("  %s at (%d, %d) %d pixels", reg->classes[c].name, blob->x_center, blob->y_center,
+                   blob->pixel_count);
+            detected++;
+        }
+        printf("%s\n", detected == 0 ? "  no detection" : "");
+    }
+
+    frame_corpus_summary_t summary;
+    frame_corpus_summarize(&corpus, &summary);
+    printf("corpus %s: %d frames, %d failed, %d skipped, %s pipeline, %.1f frames/s, latency p50 %.3f p90 %.3f p99 %.3f "
+           "max %.3f ms, reading %.3f ms/frame %s, waited %.3f ms/frame\n",
+           dir, summary.frames, summary.errors, summary.failed, detector_pipeline_name(cfg->pipeline), summary.fps,
+           summary.p50_us / 1000.0, summary.p90_us / 1000.0, summary.p99_us / 1000.0, summary.max_us / 1000.0,
+           summary.frames ? summary.load_us / 1000.0 / summary.frames : 0.0,
+           prefetch ? "prefetched" : "inline", summary.frames ? summary.wait_us / 1000.0 / summary.frames : 0.0);
+    if (summary.frames + summary.errors == 0)
+    {
+        ESP_LOGE(TAG, "No frames in %s!", dir);
+        ok = false;
+    }
+    if (allocs != 0)
+    {
+        ESP_LOGE(TAG, "Corpus frames allocated %zu times!", allocs);
+        ok = false;
+    }
+    detector_free(&det);
+    frame_corpus_close(&corpus);
+    return ok;
+}
+
+// Every kernel variant the host can run against rgb565_to_hsv +
+// matches_threshold: all 65536 inputs, plain and byte-swapped, for random
+// threshold sets and partial spans
+static int fuzz_kernels(uint32_t seed, int sets)
+{
+    static uint8_t hsv_ok[CLASS_LUT_MAX_CLASSES][CLASS_LUT_SIZE];
+    int mismatches = 0;
+
+    printf("class kernels");
+    for (int v = 0; v < CLASS_KERNEL_COUNT; v++)
+    {
+        if (class_kernel_available(v))
+            printf(" %s", class_kernel_name(v));
+    }
+    for (int set = 0; set < sets; set++)
+    {
+        color_threshold_t thresholds[CLASS_LUT_MAX_CLASSES];
+        int count = 1 + xorshift32(&seed) % CLASS_LUT_MAX_CLASSES;
+        bool swapped = xorshift32(&seed) & 1;
+        for (int c = 0; c < count; c++)
+        {
+            random_range(&seed, 100, &thresholds[c].h_min, &thresholds[c].h_max);
+            random_range(&seed, 256, &thresholds[c].s_min, &thresholds[c].s_max);
+            random_range(&seed, 256, &thresholds[c].v_min, &thresholds[c].v_max);
+        }
+        for (int i = 0; i < CLASS_LUT_SIZE; i++)
+        {
+            uint16_t rgb565 = swapped ? (uint16_t)(i << 8 | i >> 8) : (uint16_t)i;
+            hsv_t hsv = rgb565_to_hsv(rgb565);
+            for (int c = 0; c < count; c++)
+                hsv_ok[c][i] = matches_threshold(hsv, thresholds[c]);
+        }
+
+        for (int v = 0; v < CLASS_KERNEL_COUNT; v++)
+        {
+            if (!class_kernel_available(v))
+                continue;
+            class_kernel_t kernel;
+            class_kernel_init(&kernel, v, thresholds, count, swapped);
+            for (int i = 0; i < CLASS_LUT_SIZE; i += 32)
+            {
+                uint16_t pixels[32];
+                uint32_t bits[CLASS_LUT_MAX_CLASSES];
+                int n = xorshift32(&seed) % 8 == 0 ? 1 + xorshift32(&seed) % 32 : 32;
+                for (int k = 0; k < 32; k++)
+                    pixels[k] = (uint16_t)(i + k);
+                class_kernel_classify(&kernel, pixels, n, bits);
+
+                uint32_t taken = 0;
+                for (int c = 0; c < count; c++)
+                {
+                    uint32_t expect = 0;
+                    for (int k = 0; k < n; k++)
+                        expect |= (uint32_t)hsv_ok[c][i + k] << k;
+                    expect &= ~taken;
+                    taken |= expect;
+                    mismatches += __builtin_popcount(bits[c] ^ expect);
+                }
+            }
+        }
+    }
+    printf(": %d mismatches against scalar HSV path over %d random threshold sets, %s by default\n", mismatches,
+           sets, class_kernel_name(CLASS_KERNEL_DEFAULT));
+    return mismatches;
+}
+
+// Classification alone, one frame into class masks: the table against every
+// kernel variant, best of runs
+static void time_classify(const frame_t *frame, const colour_registry_t *reg, int runs)
+{
+    const pixel_frame_t *image = &frame->image;
+    pixel_mask_t masks[CLASS_LUT_MAX_CLASSES];
+    color_threshold_t thresholds[CLASS_LUT_MAX_CLASSES];
+    colour_registry_thresholds(reg, thresholds);
+    for (int c = 0; c < reg->count; c++)
+    {
+        if (!pixel_mask_init(&masks[c], image->width, image->height, MALLOC_CAP_INTERNAL))
+            return;
+    }
+
+    printf("classify %s into masks:", frame->name);
+    for (int v = -1; v < CLASS_KERNEL_COUNT; v++)
+    {
+        // v -1 is the table
+        class_lut_t lut;
+        if ((v >= 0 && !class_kernel_available(v)) ||
+            !class_lut_init_format(&lut, v < 0 ? CLASS_LUT_MEM_INTERNAL : CLASS_LUT_MEM_NONE, image->format))
+            continue;
+        if (v >= 0)
+            class_lut_set_kernel(&lut, v);
+        class_lut_update(&lut, thresholds, reg->count);
+        int64_t best = 0;
+        for (int r = 0; r < runs; r++)
+        {
+            int64_t t0 = esp_timer_get_time();
+            for (int y = 0; y < image->height; y++)
+                class_lut_classify_row(&lut, pixel_frame_row(image, y), y, masks);
+            int64_t us = esp_timer_get_time() - t0;
+            if (r == 0 || us < best)
+                best = us;
+        }
+        printf("  %s %.3f ms", v < 0 ? "table" : class_kernel_name(v), best / 1000.0);
+        class_lut_free(&lut);
+    }
+    printf("\n");
+    for (int c = 0; c < reg->count; c++)
+        pixel_mask_free(&masks[c]);
+}
+
+// Runs one frame through a context that lives for the whole pipeline, like
+// on the device. The untimed first run may still grow the context's tables;
+// the timed runs after it must not touch the heap at all.
+static bool bench_pipeline(const frame_t *frame, detector_t *det, int runs,
+                           const colour_registry_t *reg, const class_lut_t *lut, text_t *dump,
+                           detect_prof_t *prof, detect_prof_format_t prof_format)
+{
+    const detector_config_t *cfg = &det->config;
+    bench_stats_t stats = {0};
+    frame_result_t result;
+
+    // Untimed first run warms the caches, produces the detections and the
+    // profiler records
+    det->config.prof = prof;
+    if (prof != NULL)
+        port_heap_reset_peak();
+    bool ok = detector_run(det, reg, lut, &frame->image, &result, NULL);
+    det->config.prof = NULL;
+    if (!ok)
+        return false;
+    dump_result(dump, frame->name, reg, &result);
+    if (prof != NULL)
+        detect_prof_dump(prof, prof_format);
+
+    for (int r = 0; r < runs; r++)
+    {
+        port_heap_stats_t after;
+        detector_timing_t timing;
+        port_heap_reset_peak();
+        if (!detector_run(det, reg, lut, &frame->image, &result, &timing))
+            return false;
+        port_heap_stats(&after);
+
+        stats.gate_us += timing.gate_us;
+        stats.classify_us += timing.classify_us;
+        stats.label_us += timing.label_us;
+        stats.evaluate_us += timing.evaluate_us;
+        stats.total_us += timing.total_us;
+        if (r == 0 || timing.total_us < stats.total_min_us)
+            stats.total_min_us = timing.total_us;
+        stats.allocs += after.alloc_count;
+    }
+
+    double pixels = (double)cfg->width * cfg->height;
+    double mean_us = (double)stats.total_us / runs;
+    printf("%-8s %-24s total %8.3f ms (min %8.3f)  gate %6.3f%s  classify %7.3f  label %7.3f  evaluate %6.3f ms"
+           "  %7.1f Mpix/s  arena internal %6.1f KB psram %7.1f KB spilled %6.1f KB  allocs/frame %zu\n",
+           detector_pipeline_name(cfg->pipeline), frame->name, mean_us / 1000.0,
+           stats.total_min_us / 1000.0, stats.gate_us / 1000.0 / runs, result.gated ? " skip" : "     ",
+           stats.classify_us / 1000.0 / runs,
+           stats.label_us / 1000.0 / runs, stats.evaluate_us / 1000.0 / runs,
+           pixels / mean_us, det->arena.internal.used / 1024.0, det->arena.psram.used / 1024.0,
+           det->arena.spilled_bytes / 1024.0, stats.allocs / runs);
+    if (stats.allocs != 0)
+    {
+        ESP_LOGE(TAG, "%s pipeline allocated %zu times in %d steady-state runs of %s!",
+                 detector_pipeline_name(cfg->pipeline), stats.allocs, runs, frame->name);
+        return false;
+    }
+    return true;
+}
+
+// Writes the detections to write_path and compares them with golden_path,
+// either may be NULL
+static bool check_golden(const text_t *dump, const char *golden_path, const char *write_path)
+{
+    bool ok = true;
+    if (write_path != NULL)
+    {
+        FILE *f = fopen(write_path, "w");
+        if (f == NULL || fwrite(dump->data, 1, dump->len, f) != dump->len)
+        {
+            ESP_LOGE(TAG, "Failed to write %s!", write_path);
+            ok = false;
+        }
+        if (f != NULL)
+            fclose(f);
+    }
+    if (golden_path != NULL)
+    {
+        size_t size = 0;
+        char *golden = read_file(golden_path, &size);
+        bool same = golden != NULL && size == dump->len && memcmp(golden, dump->data, size) == 0;
+        printf("golden %s: %s\n", golden_path, same ? "match" : "MISMATCH");
+        if (!same)
+        {
+            printf("--- got ---\n%.*s", (int)dump->len, dump->data);
+            ok = false;
+        }
+        free(golden);
+    }
+    return ok;
+}
+
+static void usage(void)
+{
+    fprintf(stderr, "usage: colour_bench [--width W] [--height H] [--table PATH] [--format NAME] [--pad N] [--kernel NAME]\n"
+                    "                    [--pipeline NAME] [--workers N] [--chunk N] [--gap N] [--min-pixels N] [--runs N]\n"
+                    "                    [--factor N] [--denoise N] [--gate N] [--gate-z Z] [--profile lines|json]\n"
+                    "                    [--synthetic SEED] [--sparse SEED] [--sequence N] [--tile N] [--tolerance N] [--noise N]\n"
+                    "                    [--tiled PATH] [--corpus DIR] [--no-prefetch] [--golden PATH] [--write-golden PATH]\n"
+                    "                    [--verify] frame.raw ...\n");
+}
+
+int main(int argc, char **argv)
+{
+    detector_config_t cfg = {
+        .pipeline = DETECTOR_STREAMING,
+        .width = 1134,
+        .height = 805,
+        .max_gap = 3,
+        .min_pixels = 50,
+        .workers = 2,
+        .chunk_rows = 8,
+        .pyramid_factor = 4,
+    };
+    const char *table_path = COLOUR_BENCH_DEFAULT_TABLE;
+    const char *pipeline = "all";
+    const char *golden_path = NULL;
+    const char *write_golden_path = NULL;
+    const char *tiled_path = NULL;
+    const char *corpus_dir = NULL;
+    bool prefetch = true;
+    const char *raw_paths[MAX_FRAMES];
+    uint32_t seeds[MAX_FRAMES];
+    bool sparse[MAX_FRAMES];
+    int raw_count = 0;
+    int seed_count = 0;
+    int runs = 10;
+    int sequence = 0;
+    int noise = 0;
+    int gate_samples = 0;
+    const char *profile = NULL;
+    const char *format_name = "rgb565";
+    pixel_format_t format;
+    int pad = 0;
+    const char *kernel_name = "table";
+    class_kernel_variant_t kernel = CLASS_KERNEL_DEFAULT;
+    float gate_z = COVERAGE_GATE_DEFAULT_Z;
+    frame_temporal_config_t temporal = {
+        .tile_size = 32,
+        .pixel_tolerance = 0,
+        .tile_threshold = 0,
+    };
+    bool verify = false;
+
+    for (int i = 1; i < argc; i++)
+    {
+        const char *arg = argv[i];
+        const char *value = i + 1 < argc ? argv[i + 1] : NULL;
+        bool takes_value = true;
+
+        if (strcmp(arg, "--width") == 0 && value)
+            cfg.width = atoi(value);
+        else if (strcmp(arg, "--height") == 0 && value)
+            cfg.height = atoi(value);
+        else if (strcmp(arg, "--table") == 0 && value)
+            table_path = value;
+        else if (strcmp(arg, "--format") == 0 && value)
+            format_name = value;
+        else if (strcmp(arg, "--pad") == 0 && value)
+            pad = atoi(value);
+        else if (strcmp(arg, "--kernel") == 0 && value)
+            kernel_name = value;
+        else if (strcmp(arg, "--pipeline") == 0 && value)
+            pipeline = value;
+        else if (strcmp(arg, "--workers") == 0 && value)
+            cfg.workers = atoi(value);
+        else if (strcmp(arg, "--chunk") == 0 && value)
+            cfg.chunk_rows = atoi(value);
+        else if (strcmp(arg, "--gap") == 0 && value)
+            cfg.max_gap = atoi(value);
+        else if (strcmp(arg, "--min-pixels") == 0 && value)
+            cfg.min_pixels = atoi(value);
+        else if (strcmp(arg, "--runs") == 0 && value)
+            runs = atoi(value);
+        else if (strcmp(arg, "--factor") == 0 && value)
+            cfg.pyramid_factor = atoi(value);
+        else if (strcmp(arg, "--denoise") == 0 && value)
+            cfg.denoise_radius = atoi(value);
+        else if ((strcmp(arg, "--synthetic") == 0 || strcmp(arg, "--sparse") == 0) && value &&
+                 seed_count < MAX_FRAMES)
+        {
+            sparse[seed_count] = arg[2] == 's' && arg[3] == 'p';
+            seeds[seed_count++] = (uint32_t)strtoul(value, NULL, 0);
+        }
+        else if (strcmp(arg, "--gate") == 0 && value)
+            gate_samples = atoi(value);
+        else if (strcmp(arg, "--gate-z") == 0 && value)
+            gate_z = (float)atof(value);
+        else if (strcmp(arg, "--profile") == 0 && value)
+            profile = value;
+        else if (strcmp(arg, "--sequence") == 0 && value)
+            sequence = atoi(value);
+        else if (strcmp(arg, "--tile") == 0 && value)
+            temporal.tile_size = atoi(value);
+        else if (strcmp(arg, "--tolerance") == 0 && value)
+            temporal.pixel_tolerance = atoi(value);
+        else if (strcmp(arg, "--noise") == 0 && value)
+            noise = atoi(value);
+        else if (strcmp(arg, "--tiled") == 0 && value)
+            tiled_path = value;
+        else if (strcmp(arg, "--corpus") == 0 && value)
+            corpus_dir = value;
+        else if (strcmp(arg, "--no-prefetch") == 0)
+            prefetch = false, takes_value = false;
+        else if (strcmp(arg, "--golden") == 0 && value)
+            golden_path = value;
+        else if (strcmp(arg, "--write-golden") == 0 && value)
+            write_golden_path = value;
+        else if (strcmp(arg, "--verify") == 0)
+            verify = true, takes_value = false;
+        else if (arg[0] != '-' && raw_count < MAX_FRAMES)
+            raw_paths[raw_count++] = arg, takes_value = false;
+        else
+        {
+            usage();
+            return 2;
+        }
+        if (takes_value)
+            i++;
+    }
+    if ((raw_count + seed_count + sequence == 0 && tiled_path == NULL && corpus_dir == NULL) || runs < 1 ||
+        cfg.width <= 0 || cfg.height <= 0 || cfg.max_gap < 1 || cfg.pyramid_factor < 2 || temporal.tile_size < 1 || gate_samples < 0 || pad < 0 || cfg.denoise_radius < 0 ||
+        !pixel_format_parse(format_name, &format) ||
+        (strcmp(kernel_name, "table") != 0 && !class_kernel_parse(kernel_name, &kernel)) ||
+        (profile != NULL && strcmp(profile, "lines") != 0 && strcmp(profile, "json") != 0))
+    {
+        usage();
+        return 2;
+    }
+
+    char *table = read_file(table_path, NULL);
+    colour_registry_t reg;
+    if (table == NULL || colour_registry_load(&reg, table) <= 0)
+    {
+        ESP_LOGE(TAG, "No usable colour classes in %s!", table_path);
+        return 1;
+    }
+    free(table);
+
+    class_lut_t lut;
+    color_threshold_t thresholds[CLASS_LUT_MAX_CLASSES];
+    colour_registry_thresholds(&reg, thresholds);
+    if (!class_lut_init(&lut, CLASS_LUT_MEM_INTERNAL))
+        return 1;
+    int64_t t0 = esp_timer_get_time();
+    class_lut_update(&lut, thresholds, reg.count);
+    int64_t t1 = esp_timer_get_time();
+    int lut_mismatches = class_lut_verify(&lut);
+    printf("%d colour classes, class table built in %lld us, %d mismatches against scalar HSV path\n",
+           reg.count, (long long)(t1 - t0), lut_mismatches);
+
+    lut_mismatches += fuzz_tables(0x2f6e2b1a, 4);
+    lut_mismatches += fuzz_kernels(0x6b3a9c1d, 16);
+
+    // The pipelines classify the converted frames with a table of their own
+    // format, or with a kernel; the RGB565 table still generates the frames
+    class_lut_t format_lut;
+    const class_lut_t *frame_lut = &lut;
+    bool use_kernel = strcmp(kernel_name, "table") != 0;
+    if (format != PIXEL_FORMAT_RGB565 || use_kernel)
+    {
+        if (!class_lut_init_format(&format_lut, use_kernel ? CLASS_LUT_MEM_NONE : CLASS_LUT_MEM_INTERNAL, format))
+            return 1;
+        if (use_kernel && !class_lut_set_kernel(&format_lut, kernel))
+        {
+            ESP_LOGE(TAG, "The %s kernel cannot run here!", kernel_name);
+            return 1;
+        }
+        t0 = esp_timer_get_time();
+        class_lut_update(&format_lut, thresholds, reg.count);
+        t1 = esp_timer_get_time();
+        int mismatches = class_lut_verify(&format_lut);
+        if (use_kernel)
+        {
+            printf("%s pixels classified by the %s kernel, set up in %lld us, %d mismatches against scalar HSV path\n",
+                   pixel_format_name(format), kernel_name, (long long)(t1 - t0), mismatches);
+        }
+        else
+        {
+            printf("%s class table built in %lld us, %d mismatches against scalar HSV path\n",
+                   pixel_format_name(format), (long long)(t1 - t0), mismatches);
+        }
+        lut_mismatches += mismatches;
+        frame_lut = &format_lut;
+    }
+
+    // Frames are loaded up front so the timed runs never touch the file system
+    frame_t frames[MAX_FRAMES];
+    int frame_count = 0;
+    size_t frame_bytes = (size_t)cfg.width * cfg.height * sizeof(uint16_t);
+    for (int i = 0; i < raw_count; i++)
+    {
+        size_t size = 0;
+        char *data = read_file(raw_paths[i], &size);
+        if (data == NULL || size != frame_bytes)
+        {
+            ESP_LOGE(TAG, "%s: expected %zu bytes of RGB565 for %dx%d, got %zu!",
+                     raw_paths[i], frame_bytes, cfg.width, cfg.height, size);
+            return 1;
+        }
+        const char *base = strrchr(raw_paths[i], '/');
+        snprintf(frames[frame_count].name, sizeof(frames[0].name), "%s", base ? base + 1 : raw_paths[i]);
+        frames[frame_count++].pixels = (uint16_t *)data;
+    }
+    for (int i = 0; i < seed_count && frame_count < MAX_FRAMES; i++)
+    {
+        snprintf(frames[frame_count].name, sizeof(frames[0].name), "%s-%u",
+                 sparse[i] ? "sparse" : "synthetic", (unsigned)seeds[i]);
+        frames[frame_count++].pixels = synthetic_frame(&lut, cfg.width, cfg.height, seeds[i], sparse[i]);
+    }
+    for (int f = 0; f < frame_count; f++)
+    {
+        if (!convert_frame(frames[f].pixels, cfg.width, cfg.height, format, pad, &frames[f].image))
+            return 1;
+    }
+
+    coverage_gate_t gate;
+    if (gate_samples > 0 && !coverage_gate_init(&gate, cfg.width, cfg.height, gate_samples, gate_z))
+        return 1;
+
+    bool ok = lut_mismatches == 0;
+    if (verify)
+    {
+        for (int f = 0; f < frame_count; f++)
+        {
+            ok &= verify_frame(&frames[f], &cfg, gate_samples > 0 ? &gate : NULL, &reg, frame_lut, &lut);
+        }
+    }
+
+    if (sequence > 0)
+        ok &= run_sequence(&cfg, &temporal, sequence, noise, &reg, &lut);
+    if (tiled_path != NULL)
+        ok &= run_tiled(tiled_path, &cfg, &reg, kernel_name, kernel, runs);
+    // The corpus runs one pipeline, the streaming one unless --pipeline names another
+    text_t corpus_dump = {0};
+    if (corpus_dir != NULL)
+    {
+        detector_config_t corpus_cfg = cfg;
+        for (int p = DETECTOR_FULL_FRAME; p <= DETECTOR_MORPH; p++)
+        {
+            if (strcmp(pipeline, detector_pipeline_name(p)) == 0)
+                corpus_cfg.pipeline = (detector_pipeline_t)p;
+        }
+        corpus_cfg.gate = gate_samples > 0 ? &gate : NULL;
+        ok &= run_corpus(corpus_dir, &corpus_cfg, &reg, frame_lut, format, prefetch, &corpus_dump);
+    }
+    if (frame_count == 0)
+    {
+        if (corpus_dir != NULL)
+            ok &= check_golden(&corpus_dump, golden_path, write_golden_path);
+        free(corpus_dump.data);
+        if (frame_lut != &lut)
+            class_lut_free(&format_lut);
+        class_lut_free(&lut);
+        return ok ? 0 : 1;
+    }
+
+    printf("%dx%d %s, stride %d bytes, %d runs per frame, gap %d, min pixels %d, %d workers, %d-row chunks, "
+           "pyramid 1/%d, denoise %d\n",
+           cfg.width, cfg.height, pixel_format_name(format), frames[0].image.stride, runs, cfg.max_gap,
+           cfg.min_pixels, cfg.workers, cfg.chunk_rows, cfg.pyramid_factor, cfg.denoise_radius);
+    time_classify(&frames[0], &reg, runs);
+    if (gate_samples > 0)
+    {
+        printf("coverage gate %d samples at %.1f sigma\n", gate_samples, gate_z);
+        gate.frames = 0;
+        gate.skipped = 0;
+        cfg.gate = &gate;
+    }
+    detect_prof_t prof;
+    detect_prof_format_t prof_format = profile != NULL && strcmp(profile, "json") == 0 ? DETECT_PROF_JSON
+                                                                                        : DETECT_PROF_LINES;
+    if (profile != NULL && !detect_prof_init(&prof, 4096))
+        return 1;
+    text_t dump = {0};
+    bool ran = false;
+    for (int p = DETECTOR_FULL_FRAME; p <= DETECTOR_MORPH; p++)
+    {
+        if (strcmp(pipeline, "all") != 0 && strcmp(pipeline, detector_pipeline_name(p)) != 0)
+            continue;
+
+        text_t pipeline_dump = {0};
+        detector_t det;
+        cfg.pipeline = (detector_pipeline_t)p;
+        ran = true;
+        if (!detector_init(&det, &cfg, frame_lut, NULL))
+            return 1;
+        for (int f = 0; f < frame_count; f++)
+        {
+            if (!bench_pipeline(&frames[f], &det, runs, &reg, frame_lut, &pipeline_dump,
+                                profile != NULL ? &prof : NULL, prof_format))
+            {
+                ESP_LOGE(TAG, "%s pipeline failed on %s!", detector_pipeline_name(p), frames[f].name);
+                return 1;
+            }
+        }
+        detector_free(&det);
+        // All exact pipelines must agree; the first one is the reference.
+        // The pyramid is approximate, --verify reports its deviation, and so
+        // is morph once it removes speckle.
+        if (p == DETECTOR_PYRAMID || (p == DETECTOR_MORPH && cfg.denoise_radius > 0))
+        {
+            free(pipeline_dump.data);
+        }
+        else if (dump.data == NULL)
+        {
+            dump = pipeline_dump;
+        }
+        else
+        {
+            if (pipeline_dump.len != dump.len || memcmp(pipeline_dump.data, dump.data, dump.len) != 0)
+            {
+                printf("%s pipeline detections DIFFER from %s\n", detector_pipeline_name(p),
+                       detector_pipeline_name(DETECTOR_FULL_FRAME));
+                ok = false;
+            }
+            free(pipeline_dump.data);
+        }
+    }
+    if (!ran)
+    {
+        ESP_LOGE(TAG, "Unknown pipeline %s!", pipeline);
+        return 2;
+    }
+    if (profile != NULL)
+        detect_prof_free(&prof);
+    if (gate_samples > 0)
+    {
+        printf("coverage gate short-circuited %u of %u frames\n", (unsigned)gate.skipped, (unsigned)gate.frames);
+        coverage_gate_free(&gate);
+    }
+
+    // corpus detections follow those of the frames
+    if (corpus_dump.len > 0)
+        text_printf(&dump, "%.*s", (int)corpus_dump.len, corpus_dump.data);
+    free(corpus_dump.data);
+    ok &= check_golden(&dump, golden_path, write_golden_path);
+
+    free(dump.data);
+    for (int f = 0; f < frame_count; f++)
+    {
+        free(frames[f].pixels);
+        free((void *)frames[f].image.data);
+    }
+    if (frame_lut != &lut)
+        class_lut_free(&format_lut);
+    class_lut_free(&lut);
+    return ok ? 0 : 1;
+}
@@ -4,45 +4,32 @@
 #include "esp_log.h"
 #include "esp_heap_caps.h" //use of PSRAM for large arrays
 #include "esp_psram.h"
+#include "esp_partition.h"
+#include "esp_spiffs.h"
+#include "class_lut.h"
+#include "colour_detect.h"
+#include "detector.h"
+#include "frame_corpus.h"
 
 const char *TAG = "image_processing";
 
-// HSV color structure
-typedef struct
-{
-    uint8_t h; // Hue (0-180)
-    uint8_t s; // Saturation (0-255)
-    uint8_t v; // Value (0-255)
-} hsv_t;
-
-// Color threshold structure
-typedef struct
-{
-    uint8_t h_min;
-    uint8_t h_max;
-    uint8_t s_min;
-    uint8_t s_max;
-    uint8_t v_min;
-    uint8_t v_max;
-} color_threshold_t;
-
-// Structure for detected regions
-typedef struct
-{
-    int x_center;
-    int y_center;
-    int pixel_count;
-    int min_x;
-    int max_x;
-    int min_y;
-    int max_y;
-} blob_t;
-
-#define MAX_BLOBS 10
 #define IMAGE_WIDTH 1134 // my custom image dimensions
 #define IMAGE_HEIGHT 805
+#define IMAGE_FORMAT PIXEL_FORMAT_RGB565 // layout of the embedded frame; a camera would use e.g. PIXEL_FORMAT_YUV422
+#define CLASS_TABLE_MEM CLASS_LUT_MEM_INTERNAL // CLASS_LUT_MEM_NONE classifies with class_kernel.h, saving 64 KB
 #define MIN_PIXEL_THRESHOLD 50 // Minimum pixels to consider a blob
 #define MAX_GAP 3              // Maximum gap between pixels in same blob
+#define FRAME_WORKERS 2        // bands classified and labeled in parallel, one task per core
+#define STREAM_CHUNK_ROWS 8    // rows delivered per chunk in streaming mode, like a camera DMA buffer
+#define PYRAMID_FACTOR 4       // decimation of the coarse pass in pyramid mode
+#define DENOISE_RADIUS 0       // morph mode: opening radius that removes speckle, 0 off
+#define GATE_SAMPLES 2048      // pixels sampled to rule out frames with too little colour, 0 disables
+#define PROF_RECORDS 64        // profiler ring; stage, counter and peak memory records of a frame
+#define IMAGE_PARTITION "images" // data partition holding a png2RGB565.py --tiled pack, see partitions.csv
+#define CORPUS_PARTITION "corpus" // SPIFFS partition of captured *.raw frames, see partitions.csv
+#define CORPUS_DIR "/corpus"      // where it is mounted
+
+#define PIPELINE DETECTOR_STREAMING // how a frame is processed, see detector.h
 
 // extern const uint16_t rgb565_start[] asm("_binary_lutino_brightlight_rgb565_raw_start");
 // extern const size_t RGB565_size asm("_binary_lutino_brightlight_rgb565_raw_size");
@@ -54,225 +41,175 @@ extern const size_t _binary_lutino_brightlight_rgb565_raw_size;
 
 size_t pixel_count;
 const uint16_t *pixels;
-// adjusted values with some tolerance
-color_threshold_t lutino_thresh = {
-    .h_min = 18,
-    .h_max = 32,
-    .s_min = 190,
-    .s_max = 255,
-    .v_min = 90,
-    .v_max = 255};
-
-color_threshold_t green_thresh = {
-    .h_min = 28,
-    .h_max = 48,
-    .s_min = 130,
-    .s_max = 200,
-    .v_min = 45,
-    .v_max = 255};
-
-hsv_t rgb565_to_hsv(uint16_t rgb565);
-bool matches_threshold(hsv_t hsv, color_threshold_t thresh);
-void find_blobs(bool *pixel_mask, blob_t *blobs, int *blob_count);
-
-// HSV conversion function
-hsv_t rgb565_to_hsv(uint16_t rgb565)
+
+// Colour classes are loaded at boot from the embedded table
+extern const char _binary_colour_table_txt_start[];
+
+colour_registry_t colour_registry;
+class_lut_t class_lut;
+frame_result_t frame_result;
+coverage_gate_t coverage_gate;
+detect_prof_t detect_prof;
+detector_t detector;
+
+// Prints the kept blobs of one class
+void print_class_blobs(const colour_class_t *def, const class_result_t *cls)
 {
-    hsv_t hsv;
-
-    // Extract RGB components (5-bit R, 6-bit G, 5-bit B)
-    uint8_t r = (rgb565 >> 11) & 0x1F;
-    uint8_t g = (rgb565 >> 5) & 0x3F;
-    uint8_t b = rgb565 & 0x1F;
-
-    // Scale to 8-bit
-    r = (r * 255) / 31;
-    g = (g * 255) / 63;
-    b = (b * 255) / 31;
-
-    // Find min and max
-    uint8_t min = r;
-    uint8_t max = r;
-    if (g < min)
-        min = g;
-    if (b < min)
-        min = b;
-    if (g > max)
-        max = g;
-    if (b > max)
-        max = b;
-
-    uint8_t delta = max - min;
-
-    // Value
-    hsv.v = max;
-
-    // Saturation
-    if (max == 0)
+    printf("%s blobs:\n", def->name);
+    for (int i = 0; i < cls->blob_count; i++)
     {
-        hsv.s = 0;
+        const blob_t *blob = &cls->blobs[i].blob;
+        printf("  Blob %d (size: %d pixels at [%d,%d])\n", i, blob->pixel_count, blob->x_center, blob->y_center);
     }
-    else
+    if (cls->rejected_count > 0)
     {
-        hsv.s = (delta * 255) / max;
+        printf("  Ignored %d small blobs (below threshold %d)\n", cls->rejected_count, MIN_PIXEL_THRESHOLD);
     }
+    if (cls->dropped_count > 0)
+    {
+        printf("  Ignored %d blobs (blobs array full)\n", cls->dropped_count);
+    }
+}
 
-    // Hue
-    if (delta == 0)
+// Runs every image of the tiled pack in the image partition through a
+// full-frame detector of its size, classifying it where it is mapped in
+// flash. Images of another format than the class table are skipped.
+void run_image_partition(const class_lut_t *lut)
+{
+    if (esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, IMAGE_PARTITION) == NULL)
     {
-        hsv.h = 0;
+        return;
     }
-    else
+    tiled_pack_t pack;
+    if (!tiled_pack_map(&pack, IMAGE_PARTITION))
+    {
+        return;
+    }
+
+    size_t offset = 0;
+    tiled_image_t image;
+    int images = 0;
+    while (tiled_pack_next(&pack, &offset, &image))
     {
-        int hue_temp;
-        if (max == r)
+        images++;
+        char name[TILED_IMAGE_NAME_LEN + 1];
+        snprintf(name, sizeof(name), "%.*s", TILED_IMAGE_NAME_LEN, image.header->name);
+        if (image.format != lut->format)
         {
-            hue_temp = 30 * ((g - b) / delta);
-            if (g < b)
-                hue_temp += 180;
+            printf("Flash image %s: %s, class table is %s, skipped\n", name, pixel_format_name(image.format),
+                   pixel_format_name(lut->format));
+            continue;
         }
-        else if (max == g)
+
+        detector_config_t config = {
+            .pipeline = DETECTOR_FULL_FRAME,
+            .width = image.width,
+            .height = image.height,
+            .max_gap = MAX_GAP,
+            .min_pixels = MIN_PIXEL_THRESHOLD,
+        };
+        detector_t image_detector;
+        detector_timing_t timing;
+        tiled_image_stats_t stats;
+        if (!detector_init(&image_detector, &config, lut, NULL))
         {
-            hue_temp = 30 * (2 + ((b - r) / delta));
+            break;
         }
-        else
+        if (detector_run_tiled(&image_detector, &colour_registry, lut, &image, &frame_result, &timing, &stats))
         {
-            hue_temp = 30 * (4 + ((r - g) / delta));
+            printf("Flash image %s: %d x %d, %d raw %d rle %d uniform tiles (%d skipped), %lld us\n", name,
+                   image.width, image.height, stats.raw_tiles, stats.rle_tiles, stats.uniform_tiles,
+                   stats.skipped_tiles, (long long)timing.total_us);
+            for (int c = 0; c < colour_registry.count; c++)
+            {
+                const class_result_t *cls = &frame_result.classes[c];
+                if (cls->detected)
+                {
+                    const blob_t *blob = &cls->blobs[cls->detected_blob].blob;
+                    printf("  %s detected at (%d, %d), size: %d pixels\n", colour_registry.classes[c].name,
+                           blob->x_center, blob->y_center, blob->pixel_count);
+                }
+            }
         }
-        hsv.h = (hue_temp * 180) / 360;
+        detector_free(&image_detector);
     }
-
-    return hsv;
-}
-
-// Threshold checking function
-bool matches_threshold(hsv_t hsv, color_threshold_t thresh)
-{
-    return (hsv.h >= thresh.h_min && hsv.h <= thresh.h_max &&
-            hsv.s >= thresh.s_min && hsv.s <= thresh.s_max &&
-            hsv.v >= thresh.v_min && hsv.v <= thresh.v_max);
+    if (images == 0)
+    {
+        printf("Image partition %s holds no tiled images\n", IMAGE_PARTITION);
+    }
+    tiled_pack_unmap(&pack);
 }
 
-void find_blobs(bool *pixel_mask, blob_t *blobs, int *blob_count)
+// Runs every frame of the corpus partition through the detector, the next
+// frame read on an I/O task meanwhile, and reports per-frame detections,
+// frames/s and latency percentiles. Frames must have the embedded frame's
+// size and format. An SD card mounted with esp_vfs_fat_sdmmc_mount is walked
+// the same way by opening its mount point.
+void run_corpus(detector_t *det, const class_lut_t *lut)
 {
-    bool *visited = (bool *)heap_caps_malloc(pixel_count * sizeof(bool), MALLOC_CAP_SPIRAM);
-    if (visited == NULL)
+    if (esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_DATA_SPIFFS,
+                                 CORPUS_PARTITION) == NULL)
     {
-        ESP_LOGE(TAG, "Failed to allocate visited array in PSRAM!");
-        *blob_count = 0;
         return;
     }
-
-    memset(visited, 0, pixel_count * sizeof(bool));
-    *blob_count = 0;
-    printf("starting blob detection \n");
-
-    int *stack = (int *)heap_caps_malloc(pixel_count * sizeof(int), MALLOC_CAP_SPIRAM);
-    if (stack == NULL)
+    esp_vfs_spiffs_conf_t spiffs = {
+        .base_path = CORPUS_DIR,
+        .partition_label = CORPUS_PARTITION,
+        .max_files = 2,
+        .format_if_mount_failed = false,
+    };
+    esp_err_t err = esp_vfs_spiffs_register(&spiffs);
+    if (err != ESP_OK)
     {
-        ESP_LOGE(TAG, "Failed to allocate stack in PSRAM!");
-        heap_caps_free(visited);
-        *blob_count = 0;
+        ESP_LOGE(TAG, "Failed to mount %s: %s!", CORPUS_PARTITION, esp_err_to_name(err));
         return;
     }
 
-    for (int i = 0; i < pixel_count; i++)
+    // The profiler ring is only drained after the embedded frame; run the
+    // corpus without it rather than fill the ring and drop every record
+    detect_prof_t *prof = det->config.prof;
+    det->config.prof = NULL;
+
+    frame_corpus_t corpus;
+    if (frame_corpus_open(&corpus, CORPUS_DIR, IMAGE_FORMAT, IMAGE_WIDTH, IMAGE_HEIGHT, MALLOC_CAP_SPIRAM, true))
     {
-        if (pixel_mask[i] && !visited[i])
+        pixel_frame_t frame;
+        const char *name;
+        detector_timing_t timing;
+        while (frame_corpus_next(&corpus, &frame, &name))
         {
-            // Start new blob
-            blob_t current_blob = {0};
-            current_blob.min_x = IMAGE_WIDTH;
-            current_blob.min_y = IMAGE_HEIGHT;
-            current_blob.max_x = 0;
-            current_blob.max_y = 0;
-
-            // Simple flood fill (4-connected)
-            // a DFS approach in this case
-            // int stack[pixel_count];
-            int stack_ptr = 0;
-            stack[stack_ptr++] = i; // stack push operation
-            visited[i] = true;
-
-            while (stack_ptr > 0)
+            if (!detector_run(det, &colour_registry, lut, &frame, &frame_result, &timing))
             {
-                int idx = stack[--stack_ptr];
-                int x = idx % IMAGE_WIDTH;
-                int y = idx / IMAGE_WIDTH;
-
-                // Update blob bounds
-                if (x < current_blob.min_x)
-                    current_blob.min_x = x;
-                if (x > current_blob.max_x)
-                    current_blob.max_x = x;
-                if (y < current_blob.min_y)
-                    current_blob.min_y = y;
-                if (y > current_blob.max_y)
-                    current_blob.max_y = y;
-
-                current_blob.pixel_count++;
-                current_blob.x_center += x;
-                current_blob.y_center += y;
-
-                // Check ALL pixels within MAX_GAP distance
-                for (int dy = -MAX_GAP; dy <= MAX_GAP; dy++)
-                {
-                    for (int dx = -MAX_GAP; dx <= MAX_GAP; dx++)
-                    {
-                        if (dx == 0 && dy == 0)
-                            continue; // Skip current pixel
-
-                        int nx = x + dx;
-                        int ny = y + dy;
-
-                        // Check bounds
-                        if (nx >= 0 && nx < IMAGE_WIDTH && ny >= 0 && ny < IMAGE_HEIGHT)
-                        {
-                            int nidx = ny * IMAGE_WIDTH + nx;
-
-                            if (!visited[nidx] && pixel_mask[nidx])
-                            {
-                                visited[nidx] = true;
-                                stack[stack_ptr++] = nidx;
-                            }
-                        }
-                    }
-                }
+                ESP_LOGE(TAG, "Frame processing failed on %s!", name);
+                frame_corpus_fail(&corpus);
+                continue;
             }
-
-            // Calculate center
-            if (current_blob.pixel_count > 0)
+            frame_corpus_record(&corpus, timing.total_us);
+            printf("Corpus %s: %lld us", name, (long long)timing.total_us);
+            for (int c = 0; c < colour_registry.count; c++)
             {
-                current_blob.x_center /= current_blob.pixel_count;
-                current_blob.y_center /= current_blob.pixel_count;
-
-                // Only keep blobs above minimum size
-                if (current_blob.pixel_count >= MIN_PIXEL_THRESHOLD)
-                {
-                    // blobs[(*blob_count)++] = current_blob;
-                    blobs[*blob_count] = current_blob;
-
-                    // Blob storage tracking
-                    printf("Blob %d is added to blobs array", *blob_count);
-                    printf(" (size: %d pixels at [%d,%d])",
-                           current_blob.pixel_count,
-                           current_blob.x_center,
-                           current_blob.y_center);
-                    (*blob_count)++;
-
-                    printf(" → Total blobs now: %d\n", *blob_count);
-                }
-                else
+                const class_result_t *cls = &frame_result.classes[c];
+                if (cls->detected)
                 {
-                    printf("  Ignored small blob of %d pixels (below threshold %d)\n",
-                           current_blob.pixel_count, MIN_PIXEL_THRESHOLD);
+                    const blob_t *blob = &cls->blobs[cls->detected_blob].blob;
+                    printf(", %s at (%d, %d) %d pixels", colour_registry.classes[c].name, blob->x_center,
+                           blob->y_center, blob->pixel_count);
                 }
             }
+            printf("\n");
         }
+
+        frame_corpus_summary_t summary;
+        frame_corpus_summarize(&corpus, &summary);
+        printf("Corpus: %d frames (%d failed, %d skipped), %.2f frames/s, latency p50 %lld p90 %lld p99 %lld "
+               "max %lld us, reading %lld us, waiting %lld us in total\n",
+               summary.frames, summary.errors, summary.failed, summary.fps, (long long)summary.p50_us, (long long)summary.p90_us,
+               (long long)summary.p99_us, (long long)summary.max_us, (long long)summary.load_us,
+               (long long)summary.wait_us);
+        frame_corpus_close(&corpus);
     }
-    printf(" Blob Detection Complete: %d blobs found\n", *blob_count);
-    heap_caps_free(visited);
-    heap_caps_free(stack);
+    det->config.prof = prof;
+    esp_vfs_spiffs_unregister(CORPUS_PARTITION);
 }
 
 void app_main(void)
@@ -285,9 +222,6 @@ void app_main(void)
     printf("Image loaded \n");
     printf("Size: %d, %d pixels\n", _binary_lutino_brightlight_rgb565_raw_size, pixel_count);
 
-    // color_threshold_t lutino_thresh = lutino_thresh;
-    // color_threshold_t green_thresh = green_thresh;
-
     printf("initializing PSRAM and checking availability...\n");
     if (!esp_psram_is_initialized())
     {
@@ -300,135 +234,137 @@ void app_main(void)
     printf("Total PSRAM: %d bytes (%.2f MB)\n", psram_total, psram_total / 1024.0 / 1024.0);
     printf("Free PSRAM at start: %d bytes (%.2f MB)\n", psram_free_start, psram_free_start / 1024.0 / 1024.0);
 
-    // Arrays to store pixel classifications, allocate in PSRAM
-    bool *lutino_pixels = (bool *)heap_caps_malloc(pixel_count * sizeof(bool), MALLOC_CAP_SPIRAM);
-    bool *green_pixels = (bool *)heap_caps_malloc(pixel_count * sizeof(bool), MALLOC_CAP_SPIRAM);
-
-    if (lutino_pixels == NULL || green_pixels == NULL)
+    // Load the colour classes, then build the pixel -> class table for the
+    // frame's format once; it is only rebuilt when the thresholds change
+    if (colour_registry_load(&colour_registry, _binary_colour_table_txt_start) <= 0)
     {
-        ESP_LOGE(TAG, "Failed to allocate PSRAM!");
+        ESP_LOGE(TAG, "No usable colour classes!");
         return;
     }
+    printf("Loaded %d colour classes\n", colour_registry.count);
 
-    memset(lutino_pixels, 0, pixel_count * sizeof(bool));
-    memset(green_pixels, 0, pixel_count * sizeof(bool));
-    size_t psram_after_alloc = heap_caps_get_free_size(MALLOC_CAP_SPIRAM);
-    printf("\nPSRAM after allocating arrays: %d bytes free (used %d bytes)\n",
-           psram_after_alloc, psram_free_start - psram_after_alloc);
-
-    int lutino_count = 0;
-    int green_count = 0;
-
-    // Process all pixels
-    for (int i = 0; i < pixel_count; i++)
+    color_threshold_t thresholds[CLASS_LUT_MAX_CLASSES];
+    colour_registry_thresholds(&colour_registry, thresholds);
+    if (!class_lut_init_format(&class_lut, CLASS_TABLE_MEM, IMAGE_FORMAT))
     {
-        uint16_t prc_pixel = pixels[i];
-        hsv_t hsv = rgb565_to_hsv(prc_pixel);
-
-        if (matches_threshold(hsv, lutino_thresh))
-        {
-            lutino_pixels[i] = true;
-            lutino_count++;
-        }
-        else if (matches_threshold(hsv, green_thresh))
-        {
-            green_pixels[i] = true;
-            green_count++;
-        }
+        return;
     }
-    printf("Pixel classification complete\n");
-
-    // Calculate percentage of matching pixels
-    float lutino_percent = (float)lutino_count / pixel_count * 100;
-    float green_percent = (float)green_count / pixel_count * 100;
-
-    printf("Lutino pixels: %d (%.2f%%)\n", lutino_count, lutino_percent);
-    printf("Green pixels: %d (%.2f%%)\n", green_count, green_percent);
-
-    // Check PSRAM before blob detection
-    size_t psram_before_blobs = heap_caps_get_free_size(MALLOC_CAP_SPIRAM);
-    printf("\nPSRAM before blob detection: %d bytes free\n", psram_before_blobs);
-
-    // Find blobs for lutino and green
-    blob_t lutino_blobs[MAX_BLOBS];
-    blob_t green_blobs[MAX_BLOBS];
-    int lutino_blob_count = 0;
-    int green_blob_count = 0;
-
-    printf("Lutino Blob Detection Starting...\n");
-    find_blobs(lutino_pixels, lutino_blobs, &lutino_blob_count);
-    printf("Green Blob Detection Starting...\n");
-    find_blobs(green_pixels, green_blobs, &green_blob_count);
-    // Check PSRAM after blob detection
-    size_t psram_after_blobs = heap_caps_get_free_size(MALLOC_CAP_SPIRAM);
-    printf("\nPSRAM after blob detection: %d bytes free\n", psram_after_blobs);
-
-    // Detection logic with 30% threshold and blob analysis
-    bool lutino_detected = false;
-    bool green_detected = false;
-
-    // Check lutino detection
-    if (lutino_percent >= 10.0f)
+    class_lut_update(&class_lut, thresholds, colour_registry.count);
+    int lut_mismatches = class_lut_verify(&class_lut);
+    if (class_lut.mem == CLASS_LUT_MEM_NONE)
     {
-        // Check if there's a significant blob
-        for (int i = 0; i < lutino_blob_count; i++)
-        {
-            if (lutino_blobs[i].pixel_count >= MIN_PIXEL_THRESHOLD)
-            {
-                // Calculate blob density or aspect ratio if needed
-                int blob_width = lutino_blobs[i].max_x - lutino_blobs[i].min_x;
-                int blob_height = lutino_blobs[i].max_y - lutino_blobs[i].min_y;
-                float aspect_ratio = (float)blob_width / blob_height;
-
-                // Bird-like shape typically has aspect ratio between 0.5 and 2.0
-                if (aspect_ratio > 0.3f && aspect_ratio < 3.0f)
-                {
-                    lutino_detected = true;
-                    ESP_LOGI(TAG, "Lutino detected! Center at (%d, %d), size: %d pixels",
-                             lutino_blobs[i].x_center, lutino_blobs[i].y_center,
-                             lutino_blobs[i].pixel_count);
-                    break;
-                }
-            }
-        }
+        printf("%s pixels classified by the %s kernel, %d mismatches against scalar HSV path\n",
+               pixel_format_name(class_lut.format), class_kernel_name(class_lut.kernel.variant), lut_mismatches);
+    }
+    else
+    {
+        printf("%s class table built in %s, %d mismatches against scalar HSV path\n",
+               pixel_format_name(class_lut.format),
+               class_lut.mem == CLASS_LUT_MEM_INTERNAL ? "internal SRAM" : "PSRAM", lut_mismatches);
     }
 
-    // Check green detection similarly
-    if (green_percent >= 10.0f)
+    // The pipeline modules are platform neutral; the host bench in host/ runs
+    // the same code on raw frames
+    detector_config_t detector_config = {
+        .pipeline = PIPELINE,
+        .width = IMAGE_WIDTH,
+        .height = IMAGE_HEIGHT,
+        .max_gap = MAX_GAP,
+        .min_pixels = MIN_PIXEL_THRESHOLD,
+        .workers = FRAME_WORKERS,
+        .chunk_rows = STREAM_CHUNK_ROWS,
+        .pyramid_factor = PYRAMID_FACTOR,
+        .denoise_radius = DENOISE_RADIUS,
+    };
+    if (GATE_SAMPLES > 0 &&
+        coverage_gate_init(&coverage_gate, IMAGE_WIDTH, IMAGE_HEIGHT, GATE_SAMPLES, COVERAGE_GATE_DEFAULT_Z))
     {
-        for (int i = 0; i < green_blob_count; i++)
-        {
-            if (green_blobs[i].pixel_count >= MIN_PIXEL_THRESHOLD)
-            {
-                green_detected = true;
-                ESP_LOGI(TAG, "Green detected! Center at (%d, %d), size: %d pixels",
-                         green_blobs[i].x_center, green_blobs[i].y_center,
-                         green_blobs[i].pixel_count);
-                break;
-            }
-        }
+        detector_config.gate = &coverage_gate;
+    }
+    if (detect_prof_init(&detect_prof, PROF_RECORDS))
+    {
+        detector_config.prof = &detect_prof;
+    }
+    // Working buffers are made once here; a camera loop would call
+    // detector_run per frame without touching the heap
+    if (!detector_init(&detector, &detector_config, &class_lut, NULL))
+    {
+        detect_prof_free(&detect_prof);
+        coverage_gate_free(&coverage_gate);
+        class_lut_free(&class_lut);
+        return;
+    }
+    pixel_frame_t frame;
+    detector_timing_t timing;
+    if (!pixel_frame_wrap(&frame, pixels, IMAGE_FORMAT, IMAGE_WIDTH, IMAGE_HEIGHT, 0) ||
+        !detector_run(&detector, &colour_registry, &class_lut, &frame, &frame_result, &timing))
+    {
+        ESP_LOGE(TAG, "Frame processing failed!");
+        detector_free(&detector);
+        detect_prof_free(&detect_prof);
+        coverage_gate_free(&coverage_gate);
+        class_lut_free(&class_lut);
+        return;
+    }
+    printf("Pixel classification and blob detection complete (%s pipeline, %lld us)\n",
+           detector_pipeline_name(PIPELINE), (long long)timing.total_us);
+    if (frame_result.gated)
+    {
+        printf("Coverage gate: colour too sparse, frame skipped after %lld us (%u of %u frames skipped)\n",
+               (long long)timing.gate_us, (unsigned)coverage_gate.skipped, (unsigned)coverage_gate.frames);
     }
 
-    if (lutino_detected && green_detected)
+    // Stage times, counters and peak memory, printed once the frame is done
+    if (detector_config.prof != NULL)
     {
-        printf("Both birds detected!\n");
+        detect_prof_dump(&detect_prof, DETECT_PROF_LINES);
     }
-    else if (lutino_detected)
+
+    // Per-class coverage, blobs and verdict
+    int detected_count = 0;
+    for (int c = 0; c < colour_registry.count; c++)
     {
-        printf("Lutino bird detected\n");
+        const colour_class_t *def = &colour_registry.classes[c];
+        const class_result_t *cls = &frame_result.classes[c];
+
+        printf("%s pixels: %d (%.2f%%)\n", def->name, cls->pixel_count, cls->percent);
+        print_class_blobs(def, cls);
+        if (cls->detected)
+        {
+            const blob_t *blob = &cls->blobs[cls->detected_blob].blob;
+            ESP_LOGI(TAG, "%s detected! Center at (%d, %d), size: %d pixels",
+                     def->name, blob->x_center, blob->y_center, blob->pixel_count);
+            detected_count++;
+        }
     }
-    else if (green_detected)
+
+    if (detected_count == 0)
     {
-        printf("Green bird detected\n");
+        printf("No bird detected\n");
     }
     else
     {
-        printf("No bird detected\n");
+        printf("Birds detected:");
+        for (int c = 0; c < colour_registry.count; c++)
+        {
+            if (frame_result.classes[c].detected)
+                printf(" %s", colour_registry.classes[c].name);
+        }
+        printf("\n");
     }
 
-    // Free allocated PSRAM memory
-    heap_caps_free(lutino_pixels);
-    heap_caps_free(green_pixels);
+    // Reference images flashed to their own partition, read in place
+    run_image_partition(&class_lut);
+
+    // Captured frames for threshold and throughput regression, through the
+    // same detector and its buffers
+    run_corpus(&detector, &class_lut);
+
+    // Free allocated memory
+    detector_free(&detector);
+    detect_prof_free(&detect_prof);
+    coverage_gate_free(&coverage_gate);
+    class_lut_free(&class_lut);
 
     // Final PSRAM check
     size_t psram_final = heap_caps_get_free_size(MALLOC_CAP_SPIRAM);
@@ -1,18 +1,31 @@
-from PIL import Image
-import numpy as np
+import argparse
 import os
+import struct
+
+# Tiled flash container, see components/colour_detect/include/tiled_image.h
+TILED_MAGIC = b'CDTI'
+TILED_VERSION = 1
+TILED_ALIGN = 32
+TILED_HEADER = struct.Struct('<4sHBBHHHHII16s')
+TILED_ENTRY = struct.Struct('<IIB3x')
+TILE_RAW, TILE_RLE, TILE_UNIFORM = 0, 1, 2
+FORMATS = ['rgb565', 'rgb565be', 'rgb888', 'yuv422']
+
 
 def convert_png_to_rgb565(input_file='lutino_cropped_brightlight.png', output_file='lutino_brightlight_rgb565.raw'):
     try:
+        from PIL import Image
+        import numpy as np
+
         if not os.path.exists(input_file):
             print(f"Error: {input_file} not found!")
             return False
-            
+
         img = Image.open(input_file)
         img_rgb = img.convert('RGB')
         pixels = np.array(img_rgb) # convert to a numpy array
 
-        # Direct RGB565 conversion 
+        # Direct RGB565 conversion
         r = (pixels[:,:,0] >> 3).astype(np.uint16)
         g = (pixels[:,:,1] >> 2).astype(np.uint16)
         b = (pixels[:,:,2] >> 3).astype(np.uint16)
@@ -24,9 +37,152 @@ def convert_png_to_rgb565(input_file='lutino_cropped_brightlight.png', output_fi
         print(f"Successfully converted {input_file} to {output_file}")
         print(f"Image dimensions: {img.width} x {img.height}")
         return True
-        
+
     except Exception as e:
         print(f"Conversion failed: {e}")
         return False
 
-convert_png_to_rgb565()
\ No newline at end of file
+
+def load_rgb(input_file, size):
+    """RGB bytes of a PNG, or of a raw little-endian RGB565 frame of size (w, h)"""
+    if input_file.lower().endswith('.raw'):
+        width, height = size
+        data = open(input_file, 'rb').read()
+        if len(data) != width * height * 2:
+            raise ValueError(f"{input_file}: expected {width * height * 2} bytes for {width}x{height}")
+        rgb = bytearray(width * height * 3)
+        for i, (p,) in enumerate(struct.iter_unpack('<H', data)):
+            r5, g6, b5 = p >> 11, (p >> 5) & 0x3F, p & 0x1F
+            # top bits replicated into the low ones, so truncating gives p back
+            rgb[3 * i:3 * i + 3] = bytes((r5 << 3 | r5 >> 2, g6 << 2 | g6 >> 4, b5 << 3 | b5 >> 2))
+        return width, height, bytes(rgb)
+
+    from PIL import Image
+    img = Image.open(input_file).convert('RGB')
+    return img.width, img.height, img.tobytes()
+
+
+def clamp_byte(v):
+    return 0 if v < 0 else 255 if v > 255 else v
+
+
+def encode_pixels(rgb, width, height, fmt):
+    """Frame bytes in fmt, rows packed; same conversions as the host bench"""
+    if fmt == 'rgb888':
+        return rgb
+    out = bytearray()
+    if fmt in ('rgb565', 'rgb565be'):
+        order = '<H' if fmt == 'rgb565' else '>H'
+        for i in range(0, len(rgb), 3):
+            out += struct.pack(order, (rgb[i] >> 3) << 11 | (rgb[i + 1] >> 2) << 5 | rgb[i + 2] >> 3)
+        return bytes(out)
+
+    # YUV422, Y0 U Y1 V with BT.601 full range
+    if width % 2:
+        raise ValueError("yuv422 needs an even width")
+    for i in range(0, len(rgb), 6):
+        ys, u, v = [], 0, 0
+        for r, g, b in (rgb[i:i + 3], rgb[i + 3:i + 6]):
+            ys.append(clamp_byte((19595 * r + 38470 * g + 7471 * b + 32768) >> 16))
+            u += -11059 * r - 21709 * g + 32768 * b
+            v += 32768 * r - 27439 * g - 5329 * b
+        out += bytes((ys[0], clamp_byte(128 + ((u + 65536) >> 17)), ys[1], clamp_byte(128 + ((v + 65536) >> 17))))
+    return bytes(out)
+
+
+def encode_tile(data, unit_bytes, use_rle):
+    """Uniform, run-length when it at least halves the tile (short runs classify slower than raw), else raw"""
+    units = [data[i:i + unit_bytes] for i in range(0, len(data), unit_bytes)]
+    if all(u == units[0] for u in units):
+        return TILE_UNIFORM, units[0]
+    if use_rle:
+        rle = bytearray()
+        i = 0
+        while i < len(units):
+            j = i + 1
+            while j < len(units) and j - i < 0xFFFF and units[j] == units[i]:
+                j += 1
+            rle += struct.pack('<H', j - i) + units[i]
+            i = j
+        if 2 * len(rle) <= len(data):
+            return TILE_RLE, bytes(rle)
+    return TILE_RAW, data
+
+
+def align(n):
+    return (n + TILED_ALIGN - 1) // TILED_ALIGN * TILED_ALIGN
+
+
+def build_tiled_image(name, width, height, pixels, fmt, tile, use_rle):
+    bpp = 3 if fmt == 'rgb888' else 2
+    unit_bytes = 2 * bpp if fmt == 'yuv422' else bpp
+    tiles_x, tiles_y = (width + tile - 1) // tile, (height + tile - 1) // tile
+    count = tiles_x * tiles_y
+    offset = align(TILED_HEADER.size + count * TILED_ENTRY.size)
+    entries, blobs, kinds = [], [], [0, 0, 0]
+
+    for ty in range(tiles_y):
+        for tx in range(tiles_x):
+            x0, y0 = tx * tile, ty * tile
+            tw, th = min(tile, width - x0), min(tile, height - y0)
+            data = b''.join(pixels[((y0 + y) * width + x0) * bpp:((y0 + y) * width + x0 + tw) * bpp]
+                            for y in range(th))
+            kind, blob = encode_tile(data, unit_bytes, use_rle)
+            entries.append(TILED_ENTRY.pack(offset, len(blob), kind))
+            blobs.append((offset, blob))
+            kinds[kind] += 1
+            offset = align(offset + len(blob))
+
+    total = blobs[-1][0] + len(blobs[-1][1])
+    image = bytearray(b'\xff' * total)
+    image[0:TILED_HEADER.size] = TILED_HEADER.pack(TILED_MAGIC, TILED_VERSION, FORMATS.index(fmt), 0, width,
+                                                   height, tile, tile, count, total, name.encode()[:16])
+    directory = b''.join(entries)
+    image[TILED_HEADER.size:TILED_HEADER.size + len(directory)] = directory
+    for at, blob in blobs:
+        image[at:at + len(blob)] = blob
+    return bytes(image), kinds
+
+
+def convert_to_tiled(inputs, output_file, fmt='rgb565', tile=32, size=(1134, 805), use_rle=True):
+    """Packs every input into one tiled container, ready for the image partition"""
+    try:
+        pack = bytearray()
+        for input_file in inputs:
+            width, height, rgb = load_rgb(input_file, size)
+            pixels = encode_pixels(rgb, width, height, fmt)
+            name = os.path.splitext(os.path.basename(input_file))[0]
+            image, kinds = build_tiled_image(name, width, height, pixels, fmt, tile, use_rle)
+            # images of a pack start aligned, the gap reads like erased flash
+            pack += b'\xff' * (align(len(pack)) - len(pack)) + image
+            print(f"{input_file}: {width} x {height} {fmt}, {kinds[TILE_RAW]} raw, {kinds[TILE_RLE]} rle, "
+                  f"{kinds[TILE_UNIFORM]} uniform {tile}x{tile} tiles, {len(image)} bytes "
+                  f"({len(image) * 100 // len(pixels)}% of raw)")
+        with open(output_file, 'wb') as f:
+            f.write(pack)
+        print(f"Successfully wrote {len(inputs)} images, {len(pack)} bytes to {output_file}")
+        return True
+
+    except Exception as e:
+        print(f"Conversion failed: {e}")
+        return False
+
+
+if __name__ == '__main__':
+    parser = argparse.ArgumentParser(description="Without arguments converts lutino_cropped_brightlight.png "
+                                                 "to a raw RGB565 frame; with --tiled packs images for flash")
+    parser.add_argument('inputs', nargs='*', help="PNG files, or raw RGB565 frames of --size")
+    parser.add_argument('--tiled', metavar='OUT', help="write a tiled container pack of all inputs")
+    parser.add_argument('--format', choices=FORMATS, default='rgb565')
+    parser.add_argument('--tile', type=int, default=32, help="tile side in pixels (32)")
+    parser.add_argument('--size', default='1134x805', help="size of raw inputs (1134x805)")
+    parser.add_argument('--no-rle', action='store_true', help="store non-uniform tiles raw")
+    args = parser.parse_args()
+
+    if args.tiled is None:
+        convert_png_to_rgb565(*args.inputs[:1])
+    elif not args.inputs or args.tile < 2 or args.tile > 0xFFFF or args.tile % 2:
+        parser.error("--tiled needs inputs and an even tile size")
+    else:
+        width, height = (int(v) for v in args.size.split('x'))
+        convert_to_tiled(args.inputs, args.tiled, args.format, args.tile, (width, height), not args.no_rle)